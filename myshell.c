@@ -1,1363 +1,8303 @@
-
-// myshell.c
-
-#include <dirent.h>
-#include <fcntl.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <unistd.h>
-#include <signal.h>
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <sys/wait.h>
-#include <time.h>
-
-// 指令数量
-#define NUM_OF_CMD 19
-
-// 指令编号
-#define CMD_BG 1
-#define CMD_CD 2
-#define CMD_CLR 3
-#define CMD_DIR 4
-#define CMD_ECHO 5
-#define CMD_EXEC 6
-#define CMD_EXIT 7
-#define CMD_FG 8
-#define CMD_HELP 9
-#define CMD_JOBS 10
-#define CMD_PWD 11
-#define CMD_SET 12
-#define CMD_SHIFT 13
-#define CMD_TEST 14
-#define CMD_TIME 15
-#define CMD_UMASK 16
-#define CMD_UNSET 17
-#define CMD_DECLARE 18
-#define CMD_ERROR -1
-
-// $0-$9长度
-#define DOLLAR_ENV_NUM 10
-#define DOLLAR_ENV_LEN 32
-
-// 输入长度上限
-#define MAXLINE 512
-#define CMD_LEN 128
-#define PIPE_NUM 20
-#define ARG_LEN 32
-#define MAX_ARG 20
-
-// job上限
-#define JOB_NUM 20
-
-// 运行状态数量
-#define STAT_NUM 5
-
-// 运行状态
-#define STAT_RUNNING 0
-#define STAT_DONE 1
-#define STAT_SUSPENDED 2
-#define STAT_CONTINUED 3
-#define STAT_TERMINATED 4
-
-// =====================================================================
-
-// job定义
-typedef struct job job;
-struct job
-{
-    int job_num;
-    pid_t pid;
-    int status;
-    int is_fg;
-    char cmd[MAXLINE];
-};
-
-// 环境变量
-extern char **environ;
-
-// 记录$0-$9
-char *dollar_env[DOLLAR_ENV_NUM];
-
-// 记录jobs
-job *jobs_list[JOB_NUM];
-int cur_job_num = 1;
-
-// 信号处理函数
-void sigchld_handler(int sig);
-void sigtstp_handler(int sig);
-void sigint_handler(int sig);
-void sigquit_handler(int sig);
-
-// 函数定义
-void init_shell(int argc, char *argv[]);
-void handle_job(char *line);
-int get_background_flag(char *cmd);
-int add_job(pid_t pid, char *cmd, int fg);
-void print_job_info(job *j);
-void do_line(char *line);
-void handle_pipe(char **cmds, int num);
-int parse_pipe(char *line, char **cmds);
-void handle_buildin_cmd(char *cmd);
-int get_buildin_cmd(char *cmd);
-void do_cmd(char *cmd);
-void parse_space(char *str, char **parsed);
-void handle_redirect(char **args);
-int handle_env(char **args);
-int get_cmd(char *cmd);
-void handle_cmd(char **args);
-void bg(char **args);
-void cd(char **args);
-void clr();
-void dir(char **args);
-void declare(char **args);
-void echo(char **args);
-void exec(char **args);
-void my_exit();
-void fg(char **args);
-void help(char **args);
-void jobs();
-void pwd();
-void set(char **args);
-void shift(char **args);
-void test();
-void my_time();
-void my_umask(char **args);
-void unset(char **args);
-void error_cmd(char **args);
-
-// ======================================================================
-
-// 程序入口
-int main(int argc, char *argv[])
-{
-    // 初始化shell
-    init_shell(argc, argv);
-
-    // 注册信号
-    // ctrl+c
-    signal(SIGINT, sigint_handler);
-    // ctrl+z
-    signal(SIGTSTP, sigtstp_handler);
-    signal(SIGCHLD, sigchld_handler);
-
-    // 输入
-    char line[MAXLINE];
-
-    // 输出shell提示符
-    char *buf = NULL;
-    printf("myshell:%s> ", getcwd(buf, 0));
-    free(buf);
-
-    // 输入
-    while (fgets(line, MAXLINE, stdin) != NULL)
-    {
-        // 替换换行符为'/0'
-        int i = 0;
-        while (line[i] != '\n')
-            i++;
-        line[i] = '\0';
-
-        if (strlen(line))
-        {
-            // do_line(line);
-            handle_job(line);
-        }
-
-        // 打印shell提示符
-        char *buf = NULL;
-        printf("myshell:%s> ", getcwd(buf, 0));
-        free(buf);
-    }
-}
-
-// 初始化shell
-void init_shell(int argc, char *argv[])
-{
-    // 初始化环境变量$1-$9
-    for (int i = 0; i < DOLLAR_ENV_NUM; i++)
-    {
-        dollar_env[i] = (char *)malloc(sizeof(char) * DOLLAR_ENV_LEN);
-    }
-    // 赋值环境变量$1-$9
-    for (int i = 0; i < DOLLAR_ENV_NUM; i++)
-    {
-        if (i < argc)
-        {
-            strcpy(dollar_env[i], argv[i]);
-        }
-        else
-        {
-            strcpy(dollar_env[i], "\0");
-        }
-    }
-
-    // 设置环境变量SHELL=$HOME/myshell
-    char *pwd = NULL;
-    char shell_path[64] = "";
-    strcpy(shell_path, getcwd(pwd, 0));
-    free(pwd);
-    strcat(shell_path, "/myshell");
-    setenv("shell", shell_path, 1);
-
-    // 初始化jobs
-    for (int i = 0; i < JOB_NUM; i++)
-    {
-        jobs_list[i] = NULL;
-    }
-
-    return;
-}
-
-
-// 处理job
-void handle_job(char *line)
-{
-    // 检查是否为build in指令
-    if (get_buildin_cmd(line))
-    {
-        handle_buildin_cmd(line);
-    }
-    else
-    {
-        // 检查是否背景执行
-        int is_bg = get_background_flag(line);
-
-        pid_t pid = fork();
-        if (pid < 0)
-        {
-            printf("fork error\n");
-            return;
-        }
-        else if (pid == 0)
-        {
-            signal(SIGINT, SIG_DFL);
-            signal(SIGQUIT, SIG_DFL);
-            signal(SIGTSTP, SIG_DFL);
-            signal(SIGCHLD, SIG_DFL);
-
-            do_line(line);
-            
-            exit(0);
-        }
-        else
-        {
-            // 背景执行
-            if (is_bg)
-            {
-                int i = add_job(pid, line, 0);
-                print_job_info(jobs_list[i]);
-            }
-            // 前景执行
-            else
-            {
-                add_job(pid, line, 1);
-                waitpid(pid, NULL, 0);
-            }
-        }
-    }
-    
-    return;
-}
-
-// 检查是否为背景作业
-int get_background_flag(char *cmd)
-{
-    char *pos = strchr(cmd, '&');
-    if (pos != NULL)
-    {
-        // 更改'&'为' '
-        *pos = ' ';
-        return 1;
-    }
-
-    return 0;
-}
-
-// 新增job
-int add_job(pid_t pid, char *cmd, int fg)
-{
-    for (int i = 0; i < JOB_NUM; i++)
-    {
-        if (jobs_list[i] == NULL)
-        {
-            job *new_job = (job *)malloc(sizeof(job));
-            new_job->job_num = cur_job_num++;
-            new_job->pid = pid;
-            new_job->status = STAT_RUNNING;
-            new_job->is_fg = fg;
-            strcpy(new_job->cmd, cmd);
-
-            jobs_list[i] = new_job;
-
-            return i;
-        }
-    }
-
-    printf("too many jobs\n");
-
-    return 0;
-}
-
-// 打印job信息
-void print_job_info(job *j)
-{
-    // job状态
-    char *stat[STAT_NUM];
-    stat[STAT_RUNNING] = "RUNNING";
-    stat[STAT_DONE] = "DONE";
-    stat[STAT_SUSPENDED] = "SUSPENDED";
-    stat[STAT_CONTINUED] = "CONTINUED";
-    stat[STAT_TERMINATED] = "TERMINATED";
-
-    printf("[%d]\t%s\t\t%s\n", j->job_num, stat[j->status], j->cmd);
-}
-
-// 处理整行
-void do_line(char *line)
-{
-    // 单个指令
-    char *cmds[PIPE_NUM];
-    for (int i = 0; i < PIPE_NUM; i++)
-    {
-        cmds[i] = (char *)malloc(sizeof(char) * CMD_LEN);
-        strcpy(cmds[i], "\0");
-    }
-
-    // 分割管道
-    int n = parse_pipe(line, cmds);
-    // 执行管道
-    handle_pipe(cmds, n);
-
-    // 释放内存
-    for (int i = 0; i < PIPE_NUM; i++)
-    {
-        free(cmds[i]);
-    }
-    
-    return;
-}
-
-// 处理build in指令
-void handle_buildin_cmd(char *cmd)
-{
-    // 参数
-    char *args[MAX_ARG];
-    for (int i = 0; i < MAX_ARG; i++)
-    {
-        args[i] = (char *)malloc(sizeof(char) * ARG_LEN);
-        strcpy(args[i], "\0");
-    }
-
-    // 分割参数
-    parse_space(cmd, args);
-    // 环境变量替换
-    if (handle_env(args)) return;
-    // 运行指令
-    handle_cmd(args);
-
-    // 释放内存
-    for (int i = 0; i < MAX_ARG; i++)
-    {
-        free(args[i]);
-    }
-
-    return;
-}
-
-// 识别build in指令
-int get_buildin_cmd(char *cmd)
-{
-    char cmd_copy[CMD_LEN];
-    strcpy(cmd_copy, cmd);
-    char *args0 = strtok(cmd_copy, " ");
-
-    // build in指令
-    char *buildin_cmds[10];
-    buildin_cmds[0] = "bg";
-    buildin_cmds[1] = "cd";
-    buildin_cmds[2] = "declare";
-    buildin_cmds[3] = "clr";
-    buildin_cmds[4] = "exit";
-    buildin_cmds[5] = "fg";
-    buildin_cmds[6] = "set";
-    buildin_cmds[7] = "shift";
-    buildin_cmds[8] = "umask";
-    buildin_cmds[9] = "unset";
-
-    // 逐个比较
-    for (int i = 0; i < 10; i++)
-    {
-        if (strcmp(args0, buildin_cmds[i]) == 0)
-        {
-            return 1;
-        }
-    }
-
-    return 0;
-}
-
-// 分割管道
-int parse_pipe(char *line, char **cmds)
-{
-    int i = 0;
-    char s[2] = "|";
-    char *ptr;
-
-    ptr = strtok(line, s);
-    while (ptr)
-    {
-        strcpy(cmds[i++], ptr);
-        ptr = strtok(NULL, s);
-    }
-    return i;
-}
-
-// 执行管道
-void handle_pipe(char **cmds, int num)
-{
-    int pipe_fd[PIPE_NUM+1][2];
-
-    // 创建管道
-    for (int i = 0; i < num; i++)
-    {
-        if (pipe(pipe_fd[i]))
-        {
-            printf("pipe error\n");
-            return;
-        }
-    }
-
-    for (int i = 0; i < num; i++)
-    {
-        // 创建子进程运行指令
-        pid_t pid = fork();
-        if (pid < 0)
-        {
-            printf("fork error\n");
-            return;
-        }
-        // 子进程
-        else if (pid == 0)
-        {
-            // 检查管道是否结束
-            if (i != (num-1))
-            {
-                dup2(pipe_fd[i][1], STDOUT_FILENO);
-            }
-            if (i != 0)
-            {
-                dup2(pipe_fd[i-1][0], STDIN_FILENO);
-            }
-            
-            // 关闭文件
-            for (int j = 0; j < num; j++)
-            {
-                close(pipe_fd[j][0]);
-                close(pipe_fd[j][1]);
-            }
-
-            // 处理指令
-            do_cmd(cmds[i]);
-
-            exit(0);
-        }
-        else
-        {
-            wait(NULL);
-        }
-    }
-
-    // 关闭文件
-    for (int j = 0; j < num; j++)
-    {
-        close(pipe_fd[j][0]);
-        close(pipe_fd[j][1]);
-    }
-
-    return;
-}
-
-// 处理指令
-void do_cmd(char *cmd)
-{
-    // 指令参数声明，分配内存
-    char *args[MAX_ARG];
-    for (int i = 0; i < MAX_ARG; i++)
-    {
-        args[i] = (char *)malloc(sizeof(char) * ARG_LEN);
-        strcpy(args[i], "\0");
-    }
-
-    // 分割参数
-    parse_space(cmd, args);
-    // 环境变量替换
-    if (handle_env(args)) return;
-    // 重定向处理
-    handle_redirect(args);
-    // 运行指令
-    handle_cmd(args);
-
-    // 释放内存
-    for (int i = 0; i < MAX_ARG; i++)
-    {
-        free(args[i]);
-    }
-
-    return;
-}
-
-// 按空格分割
-void parse_space(char *str, char **parsed)
-{
-    int i = 0;
-    char s[2] = " ";
-    char *ptr;
-
-    ptr = strtok(str, s);
-    while (ptr)
-    {
-        strcpy(parsed[i++], ptr);
-        ptr = strtok(NULL, s);
-    }
-
-    // for (int i = 0; strlen(parsed[i]); i++)
-    // {
-    //     printf("%s\n", parsed[i]);
-    // }
-
-    return;
-}
-
-// 重定向处理
-void handle_redirect(char **args)
-{
-    // 重定向文件名
-    char input_file[ARG_LEN];
-    char output_file[ARG_LEN];
-
-    // 查找有无重定向
-    for (int i = 0; strlen(args[i]), i < MAX_ARG; i++)
-    {
-        // 输入重定向
-        if (strcmp(args[i], "<") == 0)
-        {
-            strcpy(input_file, args[i+1]);
-            int fd = open(input_file, O_RDONLY, 0);
-            dup2(fd, STDIN_FILENO);
-            close(fd);
-        }
-        // 输出重定向
-        else if (strcmp(args[i], ">") == 0)
-        {
-            strcpy(output_file, args[i+1]);
-            int fd = open(output_file, 
-                            O_CREAT | O_TRUNC | O_WRONLY, 
-                            S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-            dup2(fd, STDOUT_FILENO);
-            close(fd);
-        }
-        // 输出重定向
-        else if (strcmp(args[i], ">>") == 0)
-        {
-            strcpy(output_file, args[i+1]);
-            int fd = open(output_file, 
-                            O_CREAT | O_APPEND | O_WRONLY, 
-                            S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-            dup2(fd, STDOUT_FILENO);
-            close(fd);
-        }
-        // 无需移位参数
-        else
-        {
-            continue;
-        }
-
-        // 把重定向符从参数去掉
-        for (int j = i; j < (MAX_ARG-2); j++)
-        {
-            strcpy(args[j], args[j+2]);
-        }
-    }
-
-    return;
-}
-
-// 环境变量处理
-int handle_env(char **args)
-{
-    for (int i = 0; i < MAX_ARG; i++)
-    {
-        if (*args[i] == '$')
-        {
-            int result = atoi(args[i] + 1);
-            // $1-$9
-            if (result > 0 && result < DOLLAR_ENV_NUM)
-            {
-                strcpy(args[i], dollar_env[result]);
-            }
-            else if (result == 0)
-            {
-                char *value = getenv(args[i] + 1);
-                //printf("%s\n", value);
-
-                // $0
-                if (strcmp(args[i] + 1, "0") == 0)
-                {
-                    strcpy(args[i], dollar_env[0]);
-                }
-                // 环境变量
-                else if (value != NULL)
-                {
-                    strcpy(args[i], value);
-                }
-                // 错误处理
-                else
-                {
-                    // printf("value: %s\n" ,value);
-                    // printf("arg: %s\n", args[i] + 1);
-                    printf("error environ variable \"%s\"\n", args[i]);
-                    return 1;
-                }
-            }
-        }
-    }
-
-    return 0;
-}
-
-// 获取指令编号
-int get_cmd(char *cmd)
-{
-    int cmd_num = CMD_ERROR;
-
-    // 指令
-    char *cmd_list[NUM_OF_CMD];
-    cmd_list[CMD_BG] = "bg";
-    cmd_list[CMD_CD] = "cd";
-    cmd_list[CMD_CLR] = "clr";
-    cmd_list[CMD_DIR] = "dir";
-    cmd_list[CMD_ECHO] = "echo";
-    cmd_list[CMD_EXEC] = "exec";
-    cmd_list[CMD_EXIT] = "exit";
-    cmd_list[CMD_FG] = "fg";
-    cmd_list[CMD_HELP] = "help";
-    cmd_list[CMD_JOBS] = "jobs";
-    cmd_list[CMD_PWD] = "pwd";
-    cmd_list[CMD_SET] = "set";
-    cmd_list[CMD_SHIFT] = "shift";
-    cmd_list[CMD_TEST] = "test";
-    cmd_list[CMD_TIME] = "time";
-    cmd_list[CMD_UMASK] = "umask";
-    cmd_list[CMD_UNSET] = "unset";
-    cmd_list[CMD_DECLARE] = "declare";
-
-    // 逐个比较
-    for (int i = 1; i < NUM_OF_CMD; i++)
-    {
-        if (strcmp(cmd, cmd_list[i]) == 0)
-        {
-            cmd_num = i;
-            break;
-        }
-    }
-
-    return cmd_num;
-}
-
-// 处理指令
-void handle_cmd(char **args)
-{
-    // 根据指令执行
-    switch (get_cmd(args[0]))
-    {
-    case CMD_BG:
-        bg(args);
-        break;
-    case CMD_CD:
-        cd(args);
-        break;
-    case CMD_CLR:
-        clr();
-        break;
-    case CMD_DIR:
-        dir(args);
-        break;
-    case CMD_DECLARE:
-        declare(args);
-        break;
-    case CMD_ECHO:
-        echo(args);
-        break;
-    case CMD_EXEC:
-        exec(args);
-        break;
-    case CMD_EXIT:
-        my_exit();
-        break;
-    case CMD_FG:
-        fg(args);
-        break;
-    case CMD_HELP:
-        help(args);
-        break;
-    case CMD_JOBS:
-        jobs();
-        break;
-    case CMD_PWD:
-        pwd();
-        break;
-    case CMD_SET:
-        set(args);
-        break;
-    case CMD_SHIFT:
-        shift(args);
-        break;
-    case CMD_TEST:
-        test();
-        break;
-    case CMD_TIME:
-        my_time();
-        break;
-    case CMD_UMASK:
-        my_umask(args);
-        break;
-    case CMD_UNSET:
-        unset(args);
-        break;
-    case CMD_ERROR:
-    default:
-        error_cmd(args);
-        break;
-    }
-
-    return;
-}
-
-// bg指令
-void bg(char **args)
-{
-    int i;
-    int job_num;
-    pid_t pid = 0;
-
-    // job number
-    if (args[1][0] = '%')
-    {
-        job_num = atoi(args[1]+1);
-        for (i = 0; i < JOB_NUM; i++)
-        {
-            if (jobs_list[i] != NULL)
-            {
-                if (jobs_list[i]->job_num == job_num)
-                {
-                    pid = jobs_list[i]->pid;
-                    break;
-                }
-            }
-        }
-
-        if (pid == 0)
-        {
-            printf("bg: error job number: %s\n", args[0]+1);
-            return;
-        }
-    }
-    // pid
-    else
-    {
-        if ((pid = atoi(args[1])) == 0)
-        {
-            printf("bg: error pid: %s\n", args[0]);
-            return;
-        }
-
-        int flag = 0;
-        for (i = 0; i < JOB_NUM; i++)
-        {
-            if (jobs_list[i] != NULL)
-            {
-                if (jobs_list[i]->pid == pid)
-                {
-                    flag = 1;
-                    break;
-                }
-            }
-        }
-
-        if (flag == 0)
-        {
-            printf("bg: process didn't exist, pid: %s\n", args[0]);
-            return;
-        }
-    }
-
-    // 发送信号
-    if (kill(-pid, SIGCONT) < 0)
-    {
-        printf("bg: send SINCONT error, pid: %d\n", pid);
-        return;
-    }
-
-    jobs_list[i]->status = STAT_CONTINUED;
-    print_job_info(jobs_list[i]);
-
-    return;
-}
-
-// cd 指令
-void cd(char **args)
-{
-    if (strlen(args[1]) == 0)
-    {
-        return;
-    }
-    if (chdir(args[1]) != 0)
-    {
-        printf("Can't find \"%s\" directory\n", args[1]);
-    }
-    return;
-}
-
-// clr指令
-void clr()
-{
-    printf("\033[H\033[J");
-    return;
-}
-
-// dir指令
-void dir(char **args)
-{
-    DIR *dp;
-    struct dirent *entry;
-    char *dir_name = strlen(args[1]) ? args[1] : ".";
-
-    // 打开文件夹
-    if ((dp = opendir(dir_name)) == NULL)
-    {
-        printf("Can't find \"%s\" directory\n", args[1]);
-        return;
-    }
-
-    // 循环打印文件名
-    while ((entry = readdir(dp)) != NULL)
-    {
-        if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, ".."))
-        {
-            printf("%s\n", entry->d_name);
-        }
-    }
-
-    // 关闭文件夹
-    closedir(dp);
-
-    return;
-}
-
-// declare指令
-void declare(char **args)
-{
-    // 循环新增变量
-    for (int i = 1; strlen(args[i]) != 0 && i < MAX_ARG; i++)
-    {
-        //printf("arg: %s\n", args[i]);
-        char *name = (char *)malloc(sizeof(char) * ARG_LEN);
-        // 变量名
-        name = strtok(args[i], "=");
-        char *value = (char *)malloc(sizeof(char) * ARG_LEN);
-        // 变量值
-        value = strtok(NULL, "=");
-        // 设置变量
-        if (setenv(name, value, 1) == -1)
-        {
-            printf("declare: error argument \"%s=%s\"\n", name, value);
-            break;
-        }
-    }
-
-    return;
-}
-
-// echo指令
-void echo(char **args)
-{
-    // 循环打印
-    for (int i = 1; strlen(args[i]); i++)
-    {
-        printf("%s ", args[i]);
-    }
-    printf("\n");
-
-    return;
-}
-
-// exec指令
-void exec(char **args)
-{
-    // 新增parent环境变量
-    char *pwd = NULL;
-    char shell_path[64] = "";
-    strcpy(shell_path, getcwd(pwd, 0));
-    free(pwd);
-    strcat(shell_path, "/myshell");
-    setenv("parent", shell_path, 1);
-
-    // 准备参数
-    char *argv[MAX_ARG];
-    for (int i = 0; i < MAX_ARG - 1; i++)
-    {
-        if (strlen(args[i + 1]))
-        {
-            argv[i] = args[i + 1];
-        }
-        else
-        {
-            argv[i] = NULL;
-        }
-    }
-    argv[MAX_ARG] = NULL;
-
-    // 调用execvp
-    if (execvp(argv[0], argv) == -1)
-    {
-        printf("exec: execvp error\n");
-    }
-
-    return;
-}
-
-// exit指令
-void my_exit()
-{
-    exit(0);
-}
-
-// fg指令
-void fg(char **args)
-{
-    int i;
-    int job_num;
-    pid_t pid = 0;
-
-    // job number
-    if (args[1][0] = '%')
-    {
-        job_num = atoi(args[1]+1);
-        for (i = 0; i < JOB_NUM; i++)
-        {
-            if (jobs_list[i] != NULL)
-            {
-                if (jobs_list[i]->job_num == job_num)
-                {
-                    pid = jobs_list[i]->pid;
-                    break;
-                }
-            }
-        }
-
-        if (pid == 0)
-        {
-            printf("fg: error job number: %s\n", args[0]+1);
-            return;
-        }
-    }
-    // pid
-    else
-    {
-        if ((pid = atoi(args[1])) == 0)
-        {
-            printf("fg: error pid: %s\n", args[0]);
-            return;
-        }
-
-        int flag = 0;
-        for (i = 0; i < JOB_NUM; i++)
-        {
-            if (jobs_list[i] != NULL)
-            {
-                if (jobs_list[i]->pid == pid)
-                {
-                    flag = 1;
-                    break;
-                }
-            }
-        }
-
-        if (flag == 0)
-        {
-            printf("fg: process didn't exist, pid: %s\n", args[0]);
-            return;
-        }
-    }
-
-    // 继续执行
-    if (jobs_list[i]->status == STAT_SUSPENDED)
-    {
-        // 发送信号
-        if (kill(-pid, SIGCONT) < 0)
-        {
-            printf("fg: send SINCONT error, pid: %d\n", pid);
-            return;
-        }
-
-        // 更改job信息
-        jobs_list[i]->status = STAT_CONTINUED;
-    }
-
-    jobs_list[i]->is_fg = 1;
-    print_job_info(jobs_list[i]);
-
-    // 等待子进程
-    waitpid(pid, NULL, 0);
-
-    return;
-}
-
-// help指令
-void help(char **args)
-{
-    // 总览
-    if (strlen(args[1]) == 0)
-    {
-        printf("myshell by dqrengg\n");
-        printf("support command:\n");
-        printf("\tbg\n");
-        printf("\tcd\n");
-        printf("\tclr\n");
-        printf("\tdir\n");
-        printf("\tdeclare\n");
-        printf("\techo\n");
-        printf("\texec\n");
-        printf("\texit\n");
-        printf("\tfg\n");
-        printf("\tjobs\n");
-        printf("\tpwd\n");
-        printf("\tset\n");
-        printf("\tshift\n");
-        printf("\ttest\n");
-        printf("\ttime\n");
-        printf("\tumask\n");
-        printf("\tunset\n");
-        printf("use \"help [cmd]\" to get more info\n");
-    }
-    // 指令帮助
-    else
-    {
-        switch (get_cmd(args[1]))
-        {
-            case CMD_BG:
-                printf("usage: bg <pid>\n");
-                printf("move <pid> to background\n");
-                break;
-            case CMD_CD:
-                printf("usage: cd <dir>\n");
-                printf("change directory to <dir>\n");
-                break;
-            case CMD_CLR:
-                printf("usage: clr\n");
-                printf("clear screen\n");
-                break;
-            case CMD_DIR:
-                printf("usage: dir <dir>\n");
-                printf("list file in <dir>\n");
-                break;
-            case CMD_DECLARE:
-                printf("usage: declare <name=value>\n");
-                printf("declare a environ variable\n");
-                break;
-            case CMD_ECHO:
-                printf("usage: echo <string>\n");
-                printf("print <string> on screen\n");
-                break;
-            case CMD_EXEC:
-                printf("uasge: exec <proc> [args...]\n");
-                printf("execute <proc> with arguments\n");
-                break;
-            case CMD_EXIT:
-                printf("usage: exit\n");
-                printf("exit shell\n");
-                break;
-            case CMD_FG:
-                printf("usage: fg <pid>\n");
-                printf("move <pid> to front ground\n");
-                break;
-            case CMD_HELP:
-                printf("usage: help [cmd]\n");
-                printf("show help page\n");
-                break;
-            case CMD_JOBS:
-                printf("uasge: jobs\n");
-                printf("show jobs list\n");
-                break;
-            case CMD_PWD:
-                printf("uasge: pwd\n");
-                printf("show current work directory\n");
-                break;
-            case CMD_SET:
-                printf("usage: set [var...]\n");
-                printf("show all environ variables or set $1-$9 with <var>\n");
-                break;
-            case CMD_SHIFT:
-                printf("uasge: shift [t]\n");
-                printf("shift $1-$9 [t] times\n");
-                break;
-            case CMD_TEST:
-                printf("test <exp>\n");
-                printf("test <exp> value\n");
-                break;
-            case CMD_TIME:
-                printf("uasge: time\n");
-                printf("show system time\n");
-                break;
-            case CMD_UMASK:
-                printf("usage: umask [mask]\n");
-                printf("set new mask with [mask]\n");
-                break;
-            case CMD_UNSET:
-                printf("usage: unset [var]\n");
-                printf("unset environ variable\n");
-                break;
-            case CMD_ERROR:
-            default:
-                printf("help: error command\n");
-                break;
-        }
-    }
-}
-
-// jobs指令
-void jobs()
-{
-    // 循环打印
-    for (int i = 0; i < JOB_NUM; i++)
-    {
-        if (jobs_list[i])
-        {
-            print_job_info(jobs_list[i]);
-        }
-    }
-    return;
-}
-
-// pwd指令
-void pwd()
-{
-    // 调用getcwd()
-    char *buf = NULL;
-    printf("%s\n", getcwd(buf, 0));
-    free(buf);
-
-    return;
-}
-
-// set指令
-void set(char **args)
-{
-    // 无参数打印全部环境变量
-    if (strlen(args[1]) == 0)
-    {
-        for (int i = 0; environ[i] != NULL; i++)
-        {
-            printf("%s\n", environ[i]);
-        }
-    }
-    // 有参数更新$1-$9
-    else
-    {
-        for (int i = 1; i < DOLLAR_ENV_NUM; i++)
-        {
-            strcpy(dollar_env[i], args[i]);
-        }
-    }
-
-    return;
-}
-
-// shift指令
-void shift(char **args)
-{
-    int time;
-
-    // 无参数等于shift 1
-    if (strlen(args[1]) == 0)
-    {
-        time = 1;
-    }
-    else if ((time = atoi(args[1])) == 0)
-    {
-        printf("set: error argument \"%s\"\n", args[1]);
-        return;
-    }
-
-    // 平移$1-$9
-    for (int j = 0; j < time; j++)
-    {
-        for (int i = 1; i < DOLLAR_ENV_NUM-1; i++)
-        {
-            strcpy(dollar_env[i], dollar_env[i+1]);
-        }
-        strcpy(dollar_env[DOLLAR_ENV_NUM - 1], "\0");
-    }
-}
-
-
-// test指令暂不支持
-void test()
-{
-    printf("true\n");
-    return;
-}
-
-// time指令
-void my_time()
-{
-    time_t timep;
-    time(&timep);
-    printf("%s", ctime(&timep));
-    return;
-}
-
-// umask指令
-void my_umask(char **args)
-{
-    // 无参数，显示目前mask
-    if (strlen(args[1]) == 0)
-    {
-        unsigned int mask;
-        umask((mask = umask(0)));
-        printf("%04o\n", mask);
-    }
-    // 有参数，更新mask
-    else
-    {
-        unsigned int mask = 0;
-        int i = 0;
-        while (args[1][i] != '\0')
-        {
-            mask = mask * 8 + (args[1][i] - '0');
-            i++;
-        }
-
-        umask(mask);
-    }
-
-    return;
-}
-
-// unset指令
-void unset(char **args)
-{
-    // 调用unsetenv
-    for (int i = 0; strlen(args[i]) && i < MAX_ARG; i++)
-    {
-        if (unsetenv(args[1]))
-        {
-            printf("set: error argument \"%s\"\n", args[1]);
-        }
-    }
-
-    return;
-}
-
-// 错误处理
-void error_cmd(char **args)
-{
-    printf("Command \"%s\" not found\n", args[0]);
-    return;
-}
-
-// SIGCHLD信号处理
-void sigchld_handler(int sig)
-{
-    pid_t pid;
-    int status;
-
-    if ((pid = waitpid(-1, &status, WNOHANG | WUNTRACED)) > 0)
-    {
-        // printf("get SIGCHLD pid: %d\n", pid);
-
-        if (WIFSTOPPED(status))
-        {
-            for (int i = 0; i < JOB_NUM; i++)
-            {
-                if (jobs_list[i] != NULL)
-                {
-                    if (jobs_list[i]->pid == pid)
-                    {
-                        jobs_list[i]->status = STAT_SUSPENDED;
-                        jobs_list[i]->is_fg = 0;
-                        return;
-                    }
-                }
-            }
-        }
-        else
-        {
-            for (int i = 0; i < JOB_NUM; i++)
-            {
-                if (jobs_list[i] != NULL)
-                {
-                    if (jobs_list[i]->pid == pid)
-                    {
-                        free(jobs_list[i]);
-                        jobs_list[i] = NULL;
-                        return;
-                    }
-                }
-            }
-        }
-    }
-
-    return;
-}
-
-// SIGTSTP信号处理
-void sigtstp_handler(int sig)
-{
-    printf("\n");
-
-    for (int i = 0; i < JOB_NUM; i++)
-    {
-        if (jobs_list[i] != NULL)
-        {
-            if (jobs_list[i]->is_fg)
-            {
-                jobs_list[i]->status = STAT_SUSPENDED;
-                jobs_list[i]->is_fg = 0;
-                kill(-(jobs_list[i]->pid), sig);
-                return;
-            }
-        }
-    }
-
-    return;
-}
-
-// SININT信号处理
-void sigint_handler(int sig)
-{
-    printf("\n");
-
-    for (int i = 0; i < JOB_NUM; i++)
-    {
-        if (jobs_list[i] != NULL)
-        {
-            if (jobs_list[i]->is_fg)
-            {
-                jobs_list[i]->status = STAT_TERMINATED;
-                jobs_list[i]->is_fg = 0;
-                kill(jobs_list[i]->pid, sig);
-                return;
-            }
-        }
-    }
-    return;
-}
-
-// SIGQUIT信号处理
-void sigquit_handler(int sig)
-{
-    return;
+
+// myshell.c
+
+#include <ctype.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pwd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <spawn.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+
+// build in指令标志
+// 必须在shell进程中执行
+#define BI_PARENT 1
+// 只输出结果、不读标准输入，可安全用于管道
+#define BI_PIPE 2
+
+// job指令记录长度上限
+#define MAXLINE 512
+
+// 默认提示符
+#define DEFAULT_PS1 "myshell:\\w> "
+
+// 输入缓冲区大小
+#define READ_BUF_SIZE 65536
+
+// 内存池默认块大小
+#define ARENA_BLOCK_SIZE 4096
+
+// AST缓存桶数及容量
+#define AST_HASH_SIZE 512
+#define AST_CACHE_MAX 1024
+
+// 词法单元类型
+#define TOK_WORD 0
+#define TOK_PIPE 1
+#define TOK_AMP 2
+#define TOK_LESS 3
+#define TOK_GREAT 4
+#define TOK_DGREAT 5
+#define TOK_SEMI 6
+#define TOK_AND 7
+#define TOK_OR 8
+#define TOK_LESSGREAT 9
+#define TOK_LESSAND 10
+#define TOK_GREATAND 11
+#define TOK_DLESS 12
+#define TOK_TLESS 13
+#define TOK_NEWLINE 14
+#define TOK_DSEMI 15
+#define TOK_LPAREN 16
+#define TOK_RPAREN 17
+
+// 语法分析结果
+#define PARSE_OK 0
+// 空行或只有注释
+#define PARSE_EMPTY 1
+// 复合指令、引号等未结束，需要继续读取
+#define PARSE_INCOMPLETE 2
+#define PARSE_ERROR 3
+
+// 复合指令类型
+#define NODE_IF 0
+#define NODE_WHILE 1
+#define NODE_UNTIL 2
+#define NODE_FOR 3
+#define NODE_CASE 4
+#define NODE_GROUP 5
+#define NODE_FUNC 6
+#define NODE_COND 7
+
+// 函数桶数
+#define FUNC_HASH_SIZE 64
+// 函数最大嵌套调用层数，避免无限递归耗尽栈空间
+#define FUNC_DEPTH_MAX 1000
+
+// 重定向打开的fd不小于此值，避免与被重定向的fd冲突
+#define REDIR_FD_MIN 10
+// do_cmd及spawn_cmd在启动进程前因重定向或展开失败时的返回值，退出码为1
+#define PID_NOT_RUN -2
+
+// PATH缓存桶数
+#define PATH_HASH_SIZE 256
+// PATH目录mtime检查间隔(秒)
+#define PATH_CHECK_INTERVAL 1
+
+// job索引桶数
+#define JOB_HASH_SIZE 256
+
+// 字符串驻留桶数
+#define INTERN_HASH_SIZE 256
+
+// dir读取目录及输出的缓冲区大小
+#define DIR_BUF_SIZE 65536
+// dir -l并行stat的线程数，文件数达到DIR_STAT_MIN才启用
+#define DIR_STAT_THREADS 4
+#define DIR_STAT_MIN 1024
+
+// dir选项
+#define DIR_LONG 1
+#define DIR_RECURSIVE 2
+
+// test一次求值中缓存的文件属性数量
+#define TEST_STAT_MAX 8
+
+// 算术表达式中变量的值作为表达式计算时的最大嵌套层数
+#define ARITH_DEPTH_MAX 64
+
+// shell变量桶数
+#define VAR_HASH_SIZE 256
+
+// 单词展开方式
+// 未加引号的展开结果按IFS分割为多个字段
+#define EXP_SPLIT 1
+// 不展开变量，只去除引号
+#define EXP_NOVARS 2
+// here-doc正文，引号保持原样
+#define EXP_HEREDOC 4
+
+// 字段内容的来源
+// 未加引号的展开结果，分割并匹配文件名
+#define FIELD_EXPANDED 0
+// 引号内或转义的内容，原样保留
+#define FIELD_QUOTED 1
+// 未加引号的单词原文，只匹配文件名
+#define FIELD_LITERAL 2
+
+// 文件名匹配的目录缓存桶数
+#define GLOB_HASH_SIZE 64
+
+// 运行状态数量
+#define STAT_NUM 5
+
+// 运行状态
+#define STAT_RUNNING 0
+#define STAT_DONE 1
+#define STAT_SUSPENDED 2
+#define STAT_CONTINUED 3
+#define STAT_TERMINATED 4
+
+// =====================================================================
+
+// job定义
+typedef struct job job;
+typedef struct proc proc;
+
+// job中管道的单个阶段
+struct proc
+{
+    // 启动失败时为-1
+    pid_t pid;
+    // 指令名，报告异常终止时使用
+    const char *name;
+    // STAT_RUNNING/STAT_DONE/STAT_SUSPENDED
+    int status;
+    int exit_status;
+    job *j;
+    // pid索引的冲突链
+    proc *next;
+};
+
+struct job
+{
+    int job_num;
+    // 进程组号，即第一个启动的阶段的pid
+    pid_t pid;
+    int status;
+    int is_fg;
+    // 最后一个阶段正在shell进程中执行，wait、jobs、fg及bg不能等待或删除此job
+    int busy;
+    // 退出状态
+    int exit_status;
+    // 开始及结束时间
+    struct timespec start;
+    struct timespec end;
+    // 资源使用，各阶段结束时由wait4取得并累加
+    struct rusage usage;
+    // 管道各阶段
+    proc *procs;
+    int proc_num;
+    // 暂停时的终端设置，fg时恢复
+    struct termios tmodes;
+    int has_tmodes;
+    // 驻留的指令字符串，相同指令的job共用
+    const char *cmd;
+    // 按job编号排列的链表
+    job *prev;
+    job *next;
+    // job编号索引的冲突链
+    job *num_next;
+};
+
+// 驻留字符串
+typedef struct intern_entry intern_entry;
+struct intern_entry
+{
+    char *str;
+    int refs;
+    intern_entry *next;
+};
+
+// 内存池块
+typedef struct arena_block arena_block;
+struct arena_block
+{
+    arena_block *next;
+    size_t size;
+    size_t used;
+    char data[];
+};
+
+// 内存池，整体释放
+typedef struct arena arena;
+struct arena
+{
+    arena_block *head;
+};
+
+// 词法单元，指向原始输入行中的片段
+typedef struct token token;
+struct token
+{
+    int type;
+    const char *start;
+    int len;
+    // 重定向前的fd编号，如2>中的2，没有时为-1
+    int fd;
+};
+
+// 重定向
+typedef struct redirect redirect;
+struct redirect
+{
+    // 重定向类型，TOK_LESS/TOK_GREAT/TOK_DGREAT/TOK_LESSGREAT/TOK_LESSAND/TOK_GREATAND/TOK_DLESS/TOK_TLESS
+    int type;
+    // 被重定向的文件描述符
+    int fd;
+    // 文件名，执行时展开变量；n>&m、n<&m为m或-，here-doc为结束标记
+    char *target;
+    // here-doc在指令列表中的序号
+    int doc;
+    redirect *next;
+};
+
+// 简单指令或复合指令
+typedef struct node node;
+typedef struct command command;
+struct command
+{
+    // 以NULL结尾的单词，执行时展开变量
+    char **words;
+    int argc;
+    redirect *redirs;
+    // 复合指令，简单指令为NULL
+    node *body;
+};
+
+// 管道
+typedef struct pipeline pipeline;
+struct pipeline
+{
+    command *cmds;
+    int num;
+    int is_bg;
+    // 以time开头，结束后报告耗时
+    int is_timed;
+    // 单个必须在shell进程中执行的build in指令
+    int is_parent;
+    // 管道原文，记录在job表中
+    char *text;
+};
+
+// 指令列表，以; && || &连接的管道
+typedef struct cmd_list cmd_list;
+struct cmd_list
+{
+    pipeline **pls;
+    // pls[i]之前的连接符，TOK_SEMI/TOK_AND/TOK_OR，pls[0]为TOK_SEMI
+    int *ops;
+    int num;
+    // 整个输入中here-doc的结束标记，正文从后续输入行读取，只记录在最外层的列表中
+    char **docs;
+    int doc_num;
+};
+
+// 复合指令
+struct node
+{
+    int type;
+    // 关键字，报告异常终止时作为指令名
+    const char *kw;
+    // NODE_IF: 条件与分支交替，最后可有else分支
+    // NODE_WHILE/NODE_UNTIL: 条件与循环体
+    // NODE_CASE: 各分支，NODE_FOR/NODE_GROUP: 单个指令列表
+    cmd_list **lists;
+    int num;
+    // NODE_FOR的变量名，为NULL时是for ((;;))，NODE_FUNC的函数名
+    char *name;
+    // NODE_FOR的单词，没有in时为NULL，for ((;;))时为三个表达式；NODE_CASE的单词为words[0]
+    // NODE_COND中[[与]]之间的单词，保留引号，求值时才展开
+    char **words;
+    int word_num;
+    // NODE_CASE各分支的模式
+    char ***pats;
+    int *pat_num;
+    // NODE_FUNC的函数体原文及其中的here-doc
+    char *text;
+    int doc_start;
+    int doc_num;
+};
+
+// 语法分析器状态
+typedef struct parser parser;
+struct parser
+{
+    token *toks;
+    int n;
+    int pos;
+    arena *a;
+    // here-doc结束标记，按出现顺序
+    char **docs;
+    int doc_num;
+    int status;
+};
+
+// 函数，函数体单独解析保存，不受AST缓存清空影响
+typedef struct func func;
+struct func
+{
+    char *name;
+    cmd_list *body;
+    arena mem;
+    // 函数体中here-doc的正文
+    char **docs;
+    // 正在执行的调用数，为0时才能释放
+    int refs;
+    // 已被重新定义，调用结束后释放
+    int dead;
+    func *next;
+};
+
+// local保存的变量原值，函数返回时恢复
+typedef struct local_var local_var;
+struct local_var
+{
+    char *name;
+    // 原来未设置时为NULL
+    char *value;
+    int exported;
+    local_var *next;
+};
+
+// 函数调用
+typedef struct frame frame;
+struct frame
+{
+    local_var *locals;
+    frame *prev;
+};
+
+// 内存池中的位置，用于回收循环每轮分配的内存
+typedef struct arena_mark arena_mark;
+struct arena_mark
+{
+    arena_block *head;
+    size_t used;
+};
+
+// AST缓存项，以输入行为键
+typedef struct ast_entry ast_entry;
+struct ast_entry
+{
+    char *line;
+    cmd_list *list;
+    // AST所占内存
+    arena mem;
+    ast_entry *next;
+};
+
+// 可增长字符串
+typedef struct strbuf strbuf;
+struct strbuf
+{
+    char *s;
+    size_t len;
+    size_t cap;
+};
+
+// 单词展开生成的字段
+typedef struct fieldlist fieldlist;
+struct fieldlist
+{
+    char **v;
+    int num;
+    int cap;
+    // 是否按IFS分割
+    int split;
+    // 正在生成的字段
+    strbuf cur;
+    // 当前字段已存在，引号可产生空字段
+    int open;
+    // 分割时同时生成匹配文件名用的模式，引号内的特殊字符加反斜杠
+    strbuf pat;
+    // 不分割时也生成模式，用于[[中==及!=的右侧
+    int pattern;
+    // 当前字段含未加引号的* ? [
+    int glob;
+};
+
+// shell变量，与environ分开存放
+typedef struct var var;
+struct var
+{
+    char *name;
+    char *value;
+    // 是否导出到子进程的环境
+    int exported;
+    var *next;
+};
+
+// getdents64返回的目录项
+typedef struct dirent64_rec dirent64_rec;
+struct dirent64_rec
+{
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// dir列出的单个文件
+typedef struct dir_entry dir_entry;
+struct dir_entry
+{
+    char *name;
+    unsigned char type;
+    // -l或类型未知时由fstatat取得
+    struct stat st;
+    int st_ok;
+};
+
+// dir -l并行stat时单个线程负责的部分，按步长交错分配
+typedef struct stat_part stat_part;
+struct stat_part
+{
+    int dirfd;
+    dir_entry *ents;
+    int num;
+    int start;
+    int step;
+};
+
+// 文件名匹配的目录缓存，目录的inode或mtime改变后重新读取
+typedef struct glob_dir glob_dir;
+struct glob_dir
+{
+    char *path;
+    ino_t ino;
+    struct timespec mtime;
+    // 按文件名排序的目录项
+    dir_entry *ents;
+    int num;
+    glob_dir *next;
+};
+
+// test缓存的文件属性，同一表达式中每个文件只stat一次
+typedef struct test_stat test_stat;
+struct test_stat
+{
+    const char *path;
+    // 是否跟随符号链接
+    int follow;
+    int ok;
+    struct stat st;
+};
+
+// test的求值状态
+typedef struct test_state test_state;
+struct test_state
+{
+    char **args;
+    int num;
+    int pos;
+    // 语法错误
+    int err;
+    // [[中的单词，求值时才展开，运算符为&&及||，==和!=按模式匹配右侧
+    int cond;
+    // 大于0时处于短路未选中的部分，只检查语法，不展开也不求值
+    int skip;
+    test_stat cache[TEST_STAT_MAX];
+    int cache_num;
+};
+
+// 算术表达式计算状态
+typedef struct arith arith;
+struct arith
+{
+    const char *p;
+    // 完整的表达式，用于报告错误
+    const char *expr;
+    int err;
+    // 大于0时处于短路未选中的部分，只检查语法，不赋值
+    int skip;
+    int depth;
+};
+
+// 带缓冲的输入，行长度不受限制
+typedef struct reader reader;
+struct reader
+{
+    int fd;
+    char *buf;
+    size_t pos;
+    size_t len;
+    // 当前行
+    char *line;
+    size_t line_cap;
+};
+
+// parallel的单个任务
+typedef struct task task;
+struct task
+{
+    char **args;
+    pid_t pid;
+    // 输出管道读端，-1表示已读完
+    int fd;
+    int done;
+    job *j;
+    // 缓存的输出，任务结束后整段写出
+    strbuf out;
+};
+
+// PATH缓存项
+typedef struct path_entry path_entry;
+struct path_entry
+{
+    char *name;
+    char *path;
+    // 所在PATH目录序号，-1表示手动指定
+    int dir_idx;
+    int hits;
+    path_entry *next;
+};
+
+// build in指令定义
+typedef struct buildin buildin;
+struct buildin
+{
+    char *name;
+    int (*func)(char **args);
+    char *usage;
+    char *desc;
+    int flags;
+};
+
+// 环境变量
+extern char **environ;
+
+// $0及位置参数$1...
+char *shell_name = NULL;
+char **pos_args = NULL;
+int pos_num = 0;
+
+// 文件名匹配的目录缓存，每行执行完毕后清空
+glob_dir *glob_hash[GLOB_HASH_SIZE];
+
+// shell变量
+var *var_hash[VAR_HASH_SIZE];
+// 导出变量组成的环境，导出的变量改变后在下次启动子进程时重建
+char **shell_envp = NULL;
+int envp_dirty = 1;
+
+// 是否为交互模式
+int interactive = 0;
+// shell读取指令的输入，子进程继承标准输入前需同步文件偏移
+reader *shell_input = NULL;
+// 标准输入被push_redirect替换的层数，大于0时不同步
+int stdin_pushed = 0;
+
+// 上一个管道的退出码($?)及各阶段的退出码(PIPESTATUS)
+int last_status = 0;
+int *pipe_status = NULL;
+int pipe_status_num = 0;
+
+// 作业控制，交互模式下shell与前景job轮流持有终端
+int job_control = 0;
+pid_t shell_pgid = 0;
+struct termios shell_tmodes;
+
+// shell维护的当前目录，NULL表示未知
+char *shell_pwd = NULL;
+// 当前目录每次改变时递增
+int pwd_gen = 0;
+
+// 提示符缓存
+char *prompt_buf = NULL;
+size_t prompt_len = 0;
+char *prompt_ps1 = NULL;
+int prompt_pwd_gen = -1;
+// 提示符含时间等随时变化的内容，不能缓存
+int prompt_dynamic = 0;
+// 用户名及主机名，只获取一次
+char *prompt_user = NULL;
+char *prompt_host = NULL;
+
+// 每行指令使用的内存池，执行完毕后重置
+arena line_arena;
+
+// 当前输入的here-doc正文，按出现顺序，分配在line_arena中
+char **doc_bodies = NULL;
+int doc_count = 0;
+int doc_cap = 0;
+
+// 最近一次语法分析的结果
+int parse_status = PARSE_OK;
+
+// 函数
+func *func_hash[FUNC_HASH_SIZE];
+// 当前函数调用，不在函数中为NULL
+frame *cur_frame = NULL;
+int func_depth = 0;
+// 所在循环层数，函数中从0开始
+int loop_depth = 0;
+// break、continue尚需跳出的循环层数
+int loop_break = 0;
+int loop_cont = 0;
+// return已执行，函数返回前不再执行后续指令
+int func_return = 0;
+int return_status = 0;
+
+// AST缓存
+ast_entry *ast_hash[AST_HASH_SIZE];
+int ast_num = 0;
+
+// PATH缓存
+path_entry *path_hash[PATH_HASH_SIZE];
+// 缓存对应的PATH及其目录
+char *path_value = NULL;
+char **path_dirs = NULL;
+struct timespec *path_mtime = NULL;
+int path_dir_num = 0;
+time_t path_checked = 0;
+
+// 记录jobs，链表按job编号排列，另以各阶段pid及job编号索引
+job *job_head = NULL;
+job *job_tail = NULL;
+proc *job_pid_hash[JOB_HASH_SIZE];
+job *job_num_hash[JOB_HASH_SIZE];
+int cur_job_num = 1;
+// 前景job
+job *fg_job = NULL;
+
+// 驻留字符串
+intern_entry *intern_hash[INTERN_HASH_SIZE];
+
+// self-pipe，信号处理函数只写入一个字节，由主循环读取后处理
+int sig_pipe[2] = {-1, -1};
+// 尚未处理的信号
+volatile sig_atomic_t sig_pending[NSIG];
+// 处理过ctrl+c，供wait等阻塞的build in指令中断
+int interrupted = 0;
+
+// 信号处理函数
+void sigchld_handler(int sig);
+void sigtstp_handler(int sig);
+void sigint_handler(int sig);
+void sigquit_handler(int sig);
+void notify_signal(int sig);
+void init_signals();
+void init_job_control();
+void give_terminal(job *j);
+void take_terminal(job *j);
+void handle_signals();
+void reap_children();
+void notify_jobs();
+void wait_event(int fd);
+int wait_fg(job *j, int timed);
+
+// 函数定义
+void init_shell(int argc, char *argv[]);
+void init_reader(reader *r, int fd, char *str);
+char *read_line(reader *r);
+void sync_reader(reader *r);
+void init_pwd();
+char *get_pwd();
+void set_pwd(char *path);
+char *normalize_path(const char *path);
+void print_prompt();
+void render_prompt(const char *ps1);
+void sb_append(strbuf *sb, const char *str, size_t len);
+void *arena_alloc(arena *a, size_t size);
+char *arena_strndup(arena *a, const char *str, size_t len);
+void arena_reset(arena *a);
+void arena_free(arena *a);
+void arena_get_mark(arena *a, arena_mark *m);
+void arena_release(arena *a, arena_mark *m);
+int lex_line(const char *line, token **toks);
+const char *lex_word(const char *c);
+int lex_cmd_start(token *t, int n);
+const char *match_paren(const char *c);
+const char *match_cond(const char *c);
+cmd_list *parse_line(const char *line, arena *a);
+cmd_list *parse_list(parser *ps, const char **stops);
+pipeline *parse_pipeline(parser *ps);
+int parse_command(parser *ps, command *c);
+redirect *parse_redirect(parser *ps);
+node *parse_compound(parser *ps);
+node *parse_cond(parser *ps);
+int parse_keyword(parser *ps, const char *kw);
+int at_word(parser *ps, const char *kw);
+void skip_newlines(parser *ps);
+int is_redirect_tok(int type);
+void syntax_error(parser *ps);
+cmd_list *get_ast(const char *line);
+void ast_clear();
+void handle_job(char *line, reader *r);
+int read_docs(const char *line, reader *r);
+int run_list(cmd_list *list);
+int run_node(node *n);
+int run_arith_for(node *n);
+int run_loop_body(cmd_list *body, arena_mark *mark);
+int loop_ctl();
+int ctl_pending();
+func *find_func(const char *name);
+void define_func(node *n);
+void free_func(func *f);
+int call_func(func *f, char **args);
+int push_redirect(redirect *r, int in_fd, int (**saved)[2], int *num);
+void pop_redirect(int (*saved)[2], int num);
+int run_pipeline(pipeline *pl);
+void set_pipe_status(int *status, int num);
+job *add_job(char *cmd, int num, int fg);
+void add_proc(job *j, int i, pid_t pid, const char *name);
+void proc_exit(proc *p, int status, struct rusage *usage);
+void update_job(job *j);
+void del_job(job *j);
+proc *find_proc(pid_t pid);
+job *find_job_pid(pid_t pid);
+job *find_job_num(int num);
+job *find_job(char *name, char *arg);
+int job_pending(job *j);
+const char *intern_str(const char *str);
+void release_str(const char *str);
+void print_job_info(job *j);
+void print_job_usage(job *j);
+double ts_diff(struct timespec *end, struct timespec *start);
+double tv_sec(struct timeval *tv);
+void print_time_usage(double real, struct rusage *ru);
+int get_exit_status(int status);
+int run_buildin(command *c, int in_fd);
+pid_t run_buildin_pipe(command *c, int out_fd, int (*pipe_fd)[2], int pipe_num, pid_t pgid, int fg, int *status);
+pid_t do_cmd(command *c, int in_fd, int out_fd, int (*pipe_fd)[2], int pipe_num, pid_t pgid, int fg);
+pid_t spawn_cmd(command *c, char **args, int in_fd, int out_fd, int (*pipe_fd)[2], int pipe_num, pid_t pgid);
+void init_child(pid_t pgid, int fg);
+void init_subshell();
+int find_cmd(char *name, char *path, size_t size);
+int spawn_redirect(redirect *r, posix_spawn_file_actions_t *actions, int *fds);
+unsigned int hash_str(const char *str);
+void path_hash_load();
+void path_hash_check();
+void path_hash_clear();
+void path_hash_add(char *name, char *path, int dir_idx);
+int path_hash_del(char *name);
+int handle_redirect(redirect *r);
+int redirect_covers(redirect *r, int fd);
+int open_redirect(redirect *r, char *target);
+int dup_target(char *target);
+int doc_fd(const char *body, size_t len);
+int move_fd_high(int fd);
+char **expand_words(command *c);
+char *expand_word(const char *word, int mode);
+int expand_into(fieldlist *f, const char *word, int mode);
+int expand_param(fieldlist *f, const char *p, int quoted);
+const char *get_param(const char *name, size_t len);
+void field_add(fieldlist *f, const char *str, size_t len, int from);
+void field_end(fieldlist *f);
+void field_push(fieldlist *f, const char *str, size_t len);
+void glob_expand(fieldlist *f);
+void glob_walk(fieldlist *f, const char *base, char **segs, int idx, int num);
+int glob_match(const char *p, const char *pe, const char *name);
+const char *glob_char(const char *p, const char *pe, char c, int *ok);
+int has_glob(const char *seg);
+glob_dir *glob_get_dir(const char *path);
+void glob_cache_clear();
+char *join_path(const char *base, const char *name);
+int valid_name(const char *name, size_t len);
+var *find_var(const char *name);
+char *get_var(const char *name);
+void set_var(const char *name, const char *value);
+void unset_var(const char *name);
+void export_var(const char *name, const char *value);
+void import_environ();
+char **get_envp();
+int cmp_var(const void *a, const void *b);
+int cmp_str(const void *a, const void *b);
+void set_pos_args(char **args, int num);
+const buildin *get_cmd(char *cmd);
+int cmp_buildin(const void *key, const void *item);
+int handle_cmd(char **args);
+int bg(char **args);
+int my_break(char **args);
+int cd(char **args);
+int clr(char **args);
+int my_continue(char **args);
+int dir(char **args);
+int list_dir(const char *path, int flags, strbuf *out);
+void stat_entries(int dirfd, dir_entry *ents, int num);
+void *stat_worker(void *arg);
+void format_entry(int dirfd, dir_entry *e, strbuf *out);
+int cmp_dir_entry(const void *a, const void *b);
+void dir_flush(strbuf *out, size_t limit);
+int read_dir(int fd, arena *names, dir_entry **ents);
+int declare(char **args);
+int echo(char **args);
+int exec(char **args);
+int my_exit(char **args);
+int export(char **args);
+int fg(char **args);
+int hash(char **args);
+int help(char **args);
+int jobs(char **args);
+int let(char **args);
+int arith_word(const char *word, long long *result);
+int arith_eval(const char *expr, long long *result);
+long long arith_comma(arith *a);
+long long arith_assign(arith *a);
+long long arith_binary(arith *a, int min);
+const char *arith_op(const char *p, int *prec);
+long long arith_apply(arith *a, const char *op, long long l, long long r);
+long long arith_unary(arith *a);
+long long arith_operand(arith *a);
+long long arith_number(arith *a);
+long long arith_get(arith *a, const char *name);
+void arith_set(arith *a, const char *name, long long value);
+void arith_space(arith *a);
+void arith_error(arith *a, const char *msg);
+int local(char **args);
+int parallel(char **args);
+pid_t spawn_task(task *t);
+void finish_task(task *t);
+int pwd(char **args);
+int my_return(char **args);
+int set(char **args);
+int shift(char **args);
+int test(char **args);
+int run_cond(node *n);
+int test_eval(test_state *ts, const char *name);
+int test_or(test_state *ts);
+int test_and(test_state *ts);
+int test_not(test_state *ts);
+int test_primary(test_state *ts);
+int test_unary(test_state *ts, const char *op, const char *arg);
+int test_binary(test_state *ts, const char *a, const char *op, const char *b);
+int is_unary_op(const char *op);
+int is_binary_op(const char *op);
+struct stat *test_get_stat(test_state *ts, const char *path, int follow);
+int test_access(struct stat *st, int mode);
+long long test_int(test_state *ts, const char *s);
+char *test_word(test_state *ts, const char *word, int pattern);
+int my_time(char **args);
+int my_umask(char **args);
+int unset(char **args);
+int my_wait(char **args);
+void error_cmd(char **args);
+
+// build in指令表，按名称排序供二分查找
+const buildin buildin_list[] =
+{
+    {"((", let, "(( <exp> ))", "same as let with a single expression", BI_PARENT},
+    {"[", test, "[ <exp> ]", "same as test", BI_PIPE},
+    {"bg", bg, "bg <pid|%job>", "move <pid> to background", BI_PARENT},
+    {"break", my_break, "break [n]", "exit from [n] enclosing loops", BI_PARENT},
+    {"cd", cd, "cd <dir>", "change directory to <dir>", BI_PARENT},
+    {"clr", clr, "clr", "clear screen", BI_PARENT},
+    {"continue", my_continue, "continue [n]", "resume the next iteration of the [n]th enclosing loop", BI_PARENT},
+    {"declare", declare, "declare <name=value>", "declare a shell variable", BI_PARENT},
+    {"dir", dir, "dir [-lR] [dir...]", "list files in <dir> sorted by name, -l with mode, size and mtime, -R recursively", BI_PIPE},
+    {"echo", echo, "echo <string>", "print <string> on screen", BI_PIPE},
+    {"exec", exec, "exec <proc> [args...]", "execute <proc> with arguments", 0},
+    {"exit", my_exit, "exit", "exit shell", BI_PARENT},
+    {"export", export, "export [name[=value]...]", "export variables to child processes, or list exported variables", BI_PARENT},
+    {"fg", fg, "fg <pid|%job>", "move <pid> to front ground", BI_PARENT},
+    {"hash", hash, "hash [-r] [-d name] [-p path name] [-t name] [name...]", "show, clear or seed the command path cache", BI_PARENT},
+    {"help", help, "help [cmd]", "show help page", BI_PIPE},
+    {"jobs", jobs, "jobs [-v]", "show jobs list, -v with time and memory usage", BI_PIPE},
+    {"let", let, "let <exp>...", "evaluate integer expressions, status 0 if the last one is not 0", BI_PARENT},
+    {"local", local, "local name[=value]...", "declare variables restored when the function returns", BI_PARENT},
+    {"parallel", parallel, "parallel [-j n] [-k] cmd [args...] [::: arg...]", "run cmd once per arg (or stdin line) with n workers, {} is replaced by arg, -k keeps output order", BI_PARENT},
+    {"pwd", pwd, "pwd", "show current work directory", BI_PIPE},
+    {"return", my_return, "return [n]", "return from a function with status [n]", BI_PARENT},
+    {"set", set, "set [arg...]", "show all variables or set positional parameters $1... to <arg>", BI_PARENT},
+    {"shift", shift, "shift [t]", "shift positional parameters [t] times", BI_PARENT},
+    {"test", test, "test <exp>", "evaluate <exp> with file, string and integer tests, result as exit status", BI_PIPE},
+    {"time", my_time, "time [pipeline]", "show system time, or time a pipeline", BI_PIPE},
+    {"umask", my_umask, "umask [mask]", "set new mask with [mask]", BI_PARENT},
+    {"unset", unset, "unset [var]", "unset variable", BI_PARENT},
+    {"wait", my_wait, "wait [-n] [-a] [pid|%job...]", "wait for jobs, -n for the first to finish, -a returns the worst exit status", BI_PARENT},
+};
+
+// 指令数量
+#define NUM_OF_CMD (sizeof(buildin_list) / sizeof(buildin_list[0]))
+
+// ======================================================================
+
+// 程序入口
+// 用法: myshell [script [args...]] 或 myshell -c cmd [name [args...]]
+int main(int argc, char *argv[])
+{
+    reader input;
+
+    // 执行-c指定的指令
+    if (argc > 2 && strcmp(argv[1], "-c") == 0)
+    {
+        init_reader(&input, -1, argv[2]);
+        // $0为name，缺省为shell本身
+        if (argc > 3)
+        {
+            init_shell(argc - 3, argv + 3);
+        }
+        else
+        {
+            init_shell(1, argv);
+        }
+    }
+    // 执行脚本文件
+    else if (argc > 1)
+    {
+        int fd = open(argv[1], O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            printf("myshell: %s: %s\n", argv[1], strerror(errno));
+            return 127;
+        }
+        init_reader(&input, fd, NULL);
+        init_shell(argc - 1, argv + 1);
+    }
+    // 读取标准输入，只有终端才显示提示符
+    else
+    {
+        init_reader(&input, STDIN_FILENO, NULL);
+        init_shell(argc, argv);
+        interactive = isatty(STDIN_FILENO);
+    }
+
+    // 注册信号
+    init_signals();
+    init_job_control();
+
+    // 输入
+    char *line;
+    shell_input = &input;
+    while (1)
+    {
+        // 报告已结束的后台job，再打印shell提示符
+        if (interactive)
+        {
+            notify_jobs();
+            print_prompt();
+        }
+
+        if ((line = read_line(&input)) == NULL)
+        {
+            break;
+        }
+
+        if (strlen(line))
+        {
+            handle_job(line, &input);
+            glob_cache_clear();
+            arena_reset(&line_arena);
+        }
+    }
+
+    return last_status;
+}
+
+// 初始化输入，str不为NULL时从字符串读取
+void init_reader(reader *r, int fd, char *str)
+{
+    r->fd = fd;
+    r->pos = 0;
+    if (str != NULL)
+    {
+        r->buf = str;
+        r->len = strlen(str);
+    }
+    else
+    {
+        r->buf = (char *)malloc(READ_BUF_SIZE);
+        r->len = 0;
+    }
+    r->line_cap = 256;
+    r->line = (char *)malloc(r->line_cap);
+}
+
+// 读取一行，去掉换行符，到达结尾返回NULL
+char *read_line(reader *r)
+{
+    size_t n = 0;
+
+    while (1)
+    {
+        // 缓冲区已读完，整块读取
+        if (r->pos == r->len)
+        {
+            ssize_t got = -1;
+            if (r->fd >= 0)
+            {
+                // 等待输入期间处理子进程状态变化
+                wait_event(r->fd);
+                while ((got = read(r->fd, r->buf, READ_BUF_SIZE)) < 0 && errno == EINTR)
+                    ;
+            }
+            if (got <= 0)
+            {
+                // 最后一行没有换行符
+                if (n == 0)
+                {
+                    return NULL;
+                }
+                break;
+            }
+            r->pos = 0;
+            r->len = got;
+        }
+
+        // 在缓冲区中查找换行符
+        char *start = r->buf + r->pos;
+        char *nl = memchr(start, '\n', r->len - r->pos);
+        size_t chunk = nl ? (size_t)(nl - start) : r->len - r->pos;
+
+        if (n + chunk + 1 > r->line_cap)
+        {
+            while (n + chunk + 1 > r->line_cap)
+            {
+                r->line_cap *= 2;
+            }
+            r->line = (char *)realloc(r->line, r->line_cap);
+        }
+        memcpy(r->line + n, start, chunk);
+        n += chunk;
+        r->pos += chunk;
+
+        if (nl)
+        {
+            r->pos++;
+            break;
+        }
+    }
+
+    r->line[n] = '\0';
+    return r->line;
+}
+
+// 标准输入为普通文件时，把文件偏移移回已读位置，让子进程从下一行继续读取
+// 只在启动可能读取标准输入的指令前调用，缓冲区中剩余的内容丢弃后重新读取
+void sync_reader(reader *r)
+{
+    if (r == NULL || r->fd != STDIN_FILENO || r->pos == r->len || stdin_pushed > 0)
+    {
+        return;
+    }
+
+    if (lseek(r->fd, -(off_t)(r->len - r->pos), SEEK_CUR) >= 0)
+    {
+        r->pos = r->len = 0;
+    }
+}
+
+// 初始化shell
+void init_shell(int argc, char *argv[])
+{
+    // 导入环境变量
+    import_environ();
+
+    // $0及位置参数
+    shell_name = strdup(argv[0]);
+    set_pos_args(argv + 1, argc - 1);
+
+    // 初始化当前目录
+    init_pwd();
+
+    // 设置环境变量SHELL=$HOME/myshell
+    char shell_path[PATH_MAX];
+    snprintf(shell_path, sizeof(shell_path), "%s/myshell", get_pwd());
+    export_var("shell", shell_path);
+
+    return;
+}
+
+
+// 内存池分配，按8字节对齐
+void *arena_alloc(arena *a, size_t size)
+{
+    size = (size + 7) & ~(size_t)7;
+
+    arena_block *b = a->head;
+    if (b == NULL || b->used + size > b->size)
+    {
+        // 新建内存块，超大的请求单独分配
+        size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        b = (arena_block *)malloc(sizeof(arena_block) + block_size);
+        if (b == NULL)
+        {
+            printf("out of memory\n");
+            exit(1);
+        }
+        b->size = block_size;
+        b->used = 0;
+        b->next = a->head;
+        a->head = b;
+    }
+
+    void *ptr = b->data + b->used;
+    b->used += size;
+    return ptr;
+}
+
+// 复制字符串片段到内存池
+char *arena_strndup(arena *a, const char *str, size_t len)
+{
+    char *copy = (char *)arena_alloc(a, len + 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+// 重置内存池，只保留一个常规大小的块供下次使用
+void arena_reset(arena *a)
+{
+    arena_block *keep = NULL;
+    arena_block *b = a->head;
+    while (b)
+    {
+        arena_block *next = b->next;
+        if (keep == NULL && b->size == ARENA_BLOCK_SIZE)
+        {
+            keep = b;
+        }
+        else
+        {
+            free(b);
+        }
+        b = next;
+    }
+
+    if (keep)
+    {
+        keep->next = NULL;
+        keep->used = 0;
+    }
+    a->head = keep;
+}
+
+// 释放内存池全部内存
+void arena_free(arena *a)
+{
+    arena_block *b = a->head;
+    while (b)
+    {
+        arena_block *next = b->next;
+        free(b);
+        b = next;
+    }
+    a->head = NULL;
+}
+
+// 记录内存池当前位置
+void arena_get_mark(arena *a, arena_mark *m)
+{
+    m->head = a->head;
+    m->used = a->head ? a->head->used : 0;
+}
+
+// 释放记录位置之后分配的内存，新的块总在链表头，旧块不会再被使用
+void arena_release(arena *a, arena_mark *m)
+{
+    while (a->head != m->head)
+    {
+        arena_block *b = a->head;
+        a->head = b->next;
+        free(b);
+    }
+    if (a->head)
+    {
+        a->head->used = m->used;
+    }
+}
+
+// 词法分析，单次扫描生成指向原始输入的词法单元，返回数量
+// 引号或${}未结束返回-1，需要继续读取
+int lex_line(const char *line, token **toks)
+{
+    // 每个词法单元至少占一个字符
+    token *t = (token *)arena_alloc(&line_arena, sizeof(token) * (strlen(line) + 1));
+    int n = 0;
+    // 紧接在<或>之前的数字为重定向的fd
+    int io_fd = -1;
+
+    const char *c = line;
+    while (*c)
+    {
+        if (*c == ' ' || *c == '\t' || *c == '\r')
+        {
+            c++;
+            continue;
+        }
+        // 注释到行尾为止
+        if (*c == '#')
+        {
+            while (*c && *c != '\n')
+            {
+                c++;
+            }
+            continue;
+        }
+
+        t[n].start = c;
+        t[n].fd = io_fd;
+        io_fd = -1;
+        const char *end = NULL;
+        if (*c == '|' && c[1] == '|')
+        {
+            t[n].type = TOK_OR;
+            c++;
+        }
+        else if (*c == '|')
+        {
+            t[n].type = TOK_PIPE;
+        }
+        else if (*c == '&' && c[1] == '&')
+        {
+            t[n].type = TOK_AND;
+            c++;
+        }
+        else if (*c == '&')
+        {
+            t[n].type = TOK_AMP;
+        }
+        else if (*c == ';' && c[1] == ';')
+        {
+            t[n].type = TOK_DSEMI;
+            c++;
+        }
+        else if (*c == ';')
+        {
+            t[n].type = TOK_SEMI;
+        }
+        else if (*c == '\n')
+        {
+            t[n].type = TOK_NEWLINE;
+        }
+        // 算术指令((...))整体作为一个单词
+        else if (*c == '(' && c[1] == '(' && (end = match_paren(c)) != NULL && end[-1] == ')')
+        {
+            t[n].type = TOK_WORD;
+            c = end;
+        }
+        else if (*c == '(' && c[1] == '(' && end == NULL)
+        {
+            return -1;
+        }
+        // 条件指令[[ ... ]]整体作为一个单词，只在指令开头识别
+        else if (*c == '[' && c[1] == '[' && (c[2] == '\0' || strchr(" \t\r\n", c[2])) && lex_cmd_start(t, n))
+        {
+            if ((end = match_cond(c)) == NULL)
+            {
+                return -1;
+            }
+            t[n].type = TOK_WORD;
+            c = end - 1;
+        }
+        else if (*c == '(')
+        {
+            t[n].type = TOK_LPAREN;
+        }
+        else if (*c == ')')
+        {
+            t[n].type = TOK_RPAREN;
+        }
+        else if (*c == '<' && c[1] == '<' && c[2] == '<')
+        {
+            t[n].type = TOK_TLESS;
+            c += 2;
+        }
+        else if (*c == '<' && c[1] == '<')
+        {
+            t[n].type = TOK_DLESS;
+            c++;
+        }
+        else if (*c == '<' && c[1] == '>')
+        {
+            t[n].type = TOK_LESSGREAT;
+            c++;
+        }
+        else if (*c == '<' && c[1] == '&')
+        {
+            t[n].type = TOK_LESSAND;
+            c++;
+        }
+        else if (*c == '<')
+        {
+            t[n].type = TOK_LESS;
+        }
+        else if (*c == '>' && c[1] == '>')
+        {
+            t[n].type = TOK_DGREAT;
+            c++;
+        }
+        else if (*c == '>' && c[1] == '&')
+        {
+            t[n].type = TOK_GREATAND;
+            c++;
+        }
+        else if (*c == '>')
+        {
+            t[n].type = TOK_GREAT;
+        }
+        // 普通单词
+        else
+        {
+            t[n].type = TOK_WORD;
+            if ((c = lex_word(c)) == NULL)
+            {
+                return -1;
+            }
+            t[n].len = c - t[n].start;
+
+            // 不超过4位的纯数字紧接重定向符号时作为fd
+            if ((*c == '<' || *c == '>') && t[n].len <= 4 && strspn(t[n].start, "0123456789") >= (size_t)t[n].len)
+            {
+                io_fd = atoi(t[n].start);
+                continue;
+            }
+            n++;
+            continue;
+        }
+        c++;
+        t[n].len = c - t[n].start;
+        n++;
+    }
+
+    *toks = t;
+    return n;
+}
+
+// 扫描c处开始的普通单词，返回单词之后的位置，引号、${}或$()未结束返回NULL
+const char *lex_word(const char *c)
+{
+    while (*c && !strchr(" \t\r\n|&;<>()", *c))
+    {
+        // 引号、转义及${}中的字符属于同一单词，end指向结束的字符
+        const char *end = c;
+        if (*c == '\\' && c[1])
+        {
+            end = c + 1;
+        }
+        else if (*c == '\'')
+        {
+            end = strchr(c + 1, '\'');
+        }
+        else if (*c == '"')
+        {
+            for (end = c + 1; *end && *end != '"'; end++)
+            {
+                if (*end == '\\' && end[1])
+                {
+                    end++;
+                }
+            }
+            end = *end ? end : NULL;
+        }
+        else if (*c == '$' && c[1] == '{')
+        {
+            end = strchr(c + 2, '}');
+        }
+        else if (*c == '$' && c[1] == '(')
+        {
+            end = match_paren(c + 1);
+        }
+        if (end == NULL)
+        {
+            return NULL;
+        }
+        c = end + 1;
+    }
+    return c;
+}
+
+// 第n个词法单元是否位于指令开头，即在连接符、括号或保留字之后
+int lex_cmd_start(token *t, int n)
+{
+    static const char *reserved[] = {"if", "then", "elif", "else", "while", "until", "do", "{", "!", "time", NULL};
+    if (n == 0)
+    {
+        return 1;
+    }
+    if (t[n-1].type != TOK_WORD)
+    {
+        return !is_redirect_tok(t[n-1].type);
+    }
+    for (int i = 0; reserved[i]; i++)
+    {
+        if ((size_t)t[n-1].len == strlen(reserved[i]) && strncmp(t[n-1].start, reserved[i], t[n-1].len) == 0)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 找到与c处的(匹配的)，跳过引号中的内容，未结束返回NULL
+const char *match_paren(const char *c)
+{
+    int depth = 0;
+    for (; *c; c++)
+    {
+        if (*c == '\\' && c[1])
+        {
+            c++;
+        }
+        else if (*c == '\'' || *c == '"')
+        {
+            const char *end = strchr(c + 1, *c);
+            if (end == NULL)
+            {
+                return NULL;
+            }
+            c = end;
+        }
+        else if (*c == '(')
+        {
+            depth++;
+        }
+        else if (*c == ')' && --depth == 0)
+        {
+            return c;
+        }
+    }
+    return NULL;
+}
+
+// 找到c处的[[之后作为单词出现的]]，跳过引号中的内容，返回]]之后的位置，未结束返回NULL
+const char *match_cond(const char *c)
+{
+    c += 2;
+    while (*c)
+    {
+        if (strchr(" \t\r\n|&;<>()", *c))
+        {
+            c++;
+        }
+        else if (c[0] == ']' && c[1] == ']' && (c[2] == '\0' || strchr(" \t\r\n|&;<>()", c[2])))
+        {
+            return c + 2;
+        }
+        else if ((c = lex_word(c)) == NULL)
+        {
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+// 语法分析，在内存池a中生成AST，结果记录在parse_status中
+// 语法错误、空行或输入未结束返回NULL
+cmd_list *parse_line(const char *line, arena *a)
+{
+    token *toks;
+    int n = lex_line(line, &toks);
+    if (n < 0)
+    {
+        parse_status = PARSE_INCOMPLETE;
+        return NULL;
+    }
+
+    // 统计here-doc数
+    int docs = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (toks[i].type == TOK_DLESS)
+        {
+            docs++;
+        }
+    }
+
+    parser ps = {toks, n, 0, a, NULL, 0, PARSE_OK};
+    ps.docs = (char **)arena_alloc(a, sizeof(char *) * (docs + 1));
+    cmd_list *list = parse_list(&ps, NULL);
+    // 多余的;;或)
+    if (ps.status == PARSE_OK && ps.pos < n)
+    {
+        syntax_error(&ps);
+    }
+
+    parse_status = ps.status;
+    if (parse_status != PARSE_OK)
+    {
+        return NULL;
+    }
+    if (list->num == 0)
+    {
+        parse_status = PARSE_EMPTY;
+        return NULL;
+    }
+    list->docs = ps.docs;
+    list->doc_num = ps.doc_num;
+    return list;
+}
+
+// 生成指令列表，按; && || &及换行分割为管道
+// 到stops中的关键字、;;、)或结尾为止，stops以NULL结尾
+cmd_list *parse_list(parser *ps, const char **stops)
+{
+    cmd_list *list = (cmd_list *)arena_alloc(ps->a, sizeof(cmd_list));
+    int cap = 4;
+    list->pls = (pipeline **)arena_alloc(ps->a, sizeof(pipeline *) * cap);
+    list->ops = (int *)arena_alloc(ps->a, sizeof(int) * cap);
+    list->num = 0;
+    list->docs = NULL;
+    list->doc_num = 0;
+
+    int op = TOK_SEMI;
+    while (1)
+    {
+        skip_newlines(ps);
+
+        // 列表结束，&&和||之后不能为空
+        int end = ps->pos >= ps->n || ps->toks[ps->pos].type == TOK_DSEMI || ps->toks[ps->pos].type == TOK_RPAREN;
+        for (int i = 0; !end && stops && stops[i]; i++)
+        {
+            end = at_word(ps, stops[i]);
+        }
+        if (end)
+        {
+            if (op != TOK_SEMI)
+            {
+                syntax_error(ps);
+                return NULL;
+            }
+            break;
+        }
+
+        int start = ps->pos;
+        pipeline *pl = parse_pipeline(ps);
+        if (pl == NULL)
+        {
+            return NULL;
+        }
+
+        // 管道原文，背景执行时包括&
+        token *last = &ps->toks[ps->pos - 1];
+
+        // 连接符
+        int type = ps->pos < ps->n ? ps->toks[ps->pos].type : TOK_NEWLINE;
+        if (type == TOK_LPAREN)
+        {
+            syntax_error(ps);
+            return NULL;
+        }
+        if (type == TOK_SEMI || type == TOK_AMP || type == TOK_AND || type == TOK_OR || type == TOK_NEWLINE)
+        {
+            ps->pos = ps->pos < ps->n ? ps->pos + 1 : ps->pos;
+        }
+        // 背景执行
+        if (type == TOK_AMP)
+        {
+            pl->is_bg = 1;
+            last++;
+        }
+
+        // 单个build in指令在shell进程中执行，只输出结果的指令在背景执行时仍需fork
+        if (pl->num == 1 && pl->cmds[0].argc > 0)
+        {
+            const buildin *b = get_cmd(pl->cmds[0].words[0]);
+            pl->is_parent = b != NULL && ((b->flags & BI_PARENT) || ((b->flags & BI_PIPE) && !pl->is_bg));
+        }
+        pl->text = arena_strndup(ps->a, ps->toks[start].start, last->start + last->len - ps->toks[start].start);
+
+        if (list->num == cap)
+        {
+            cap *= 2;
+            pipeline **pls = (pipeline **)arena_alloc(ps->a, sizeof(pipeline *) * cap);
+            int *ops = (int *)arena_alloc(ps->a, sizeof(int) * cap);
+            memcpy(pls, list->pls, sizeof(pipeline *) * list->num);
+            memcpy(ops, list->ops, sizeof(int) * list->num);
+            list->pls = pls;
+            list->ops = ops;
+        }
+        list->pls[list->num] = pl;
+        list->ops[list->num] = op;
+        list->num++;
+
+        if (type == TOK_AND || type == TOK_OR)
+        {
+            op = type;
+        }
+        else if (type == TOK_SEMI || type == TOK_AMP || type == TOK_NEWLINE)
+        {
+            op = TOK_SEMI;
+        }
+        // ;;或)结束列表
+        else
+        {
+            break;
+        }
+    }
+
+    return list;
+}
+
+// 生成单个管道，|之后可以换行
+pipeline *parse_pipeline(parser *ps)
+{
+    pipeline *pl = (pipeline *)arena_alloc(ps->a, sizeof(pipeline));
+    pl->is_bg = 0;
+    pl->is_timed = 0;
+    pl->is_parent = 0;
+
+    // time关键字，单独的time仍为显示系统时间的指令
+    if (at_word(ps, "time") && ps->pos + 1 < ps->n
+        && (ps->toks[ps->pos+1].type == TOK_WORD || is_redirect_tok(ps->toks[ps->pos+1].type)))
+    {
+        pl->is_timed = 1;
+        ps->pos++;
+    }
+
+    int cap = 2;
+    pl->cmds = (command *)arena_alloc(ps->a, sizeof(command) * cap);
+    pl->num = 0;
+    while (1)
+    {
+        if (pl->num == cap)
+        {
+            cap *= 2;
+            command *cmds = (command *)arena_alloc(ps->a, sizeof(command) * cap);
+            memcpy(cmds, pl->cmds, sizeof(command) * pl->num);
+            pl->cmds = cmds;
+        }
+        if (parse_command(ps, &pl->cmds[pl->num++]))
+        {
+            return NULL;
+        }
+
+        if (ps->pos >= ps->n || ps->toks[ps->pos].type != TOK_PIPE)
+        {
+            break;
+        }
+        ps->pos++;
+        skip_newlines(ps);
+    }
+
+    return pl;
+}
+
+// 生成单个指令，可以是简单指令、复合指令或函数定义，失败返回1
+int parse_command(parser *ps, command *c)
+{
+    c->words = NULL;
+    c->argc = 0;
+    c->redirs = NULL;
+    c->body = NULL;
+    redirect **tail = &c->redirs;
+
+    // 未在对应位置出现的保留字
+    static const char *reserved[] = {"then", "elif", "else", "fi", "do", "done", "esac", "}", NULL};
+    for (int i = 0; reserved[i]; i++)
+    {
+        if (at_word(ps, reserved[i]))
+        {
+            syntax_error(ps);
+            return 1;
+        }
+    }
+
+    // 算术指令((expr))，表达式作为((的参数，之后只能有重定向
+    int fixed = 0;
+    if (ps->pos < ps->n && ps->toks[ps->pos].type == TOK_WORD && ps->toks[ps->pos].start[0] == '(')
+    {
+        token *t = &ps->toks[ps->pos++];
+        c->words = (char **)arena_alloc(ps->a, sizeof(char *) * 3);
+        c->words[0] = arena_strndup(ps->a, "((", 2);
+        c->words[1] = arena_strndup(ps->a, t->start + 2, t->len - 4);
+        c->argc = 2;
+        fixed = 1;
+    }
+
+    // 条件指令[[ expr ]]，之后只能有重定向
+    if (ps->pos < ps->n && ps->toks[ps->pos].type == TOK_WORD && ps->toks[ps->pos].len > 2
+        && strncmp(ps->toks[ps->pos].start, "[[", 2) == 0 && strchr(" \t\r\n", ps->toks[ps->pos].start[2]))
+    {
+        c->body = parse_cond(ps);
+        if (c->body == NULL)
+        {
+            return 1;
+        }
+    }
+
+    // 复合指令
+    static const char *compound[] = {"if", "while", "until", "for", "case", "{", NULL};
+    for (int i = 0; compound[i] && !fixed && c->body == NULL; i++)
+    {
+        if (at_word(ps, compound[i]))
+        {
+            c->body = parse_compound(ps);
+            if (c->body == NULL)
+            {
+                return 1;
+            }
+        }
+    }
+
+    // 函数定义name() compound
+    if (c->body == NULL && !fixed && ps->pos + 1 < ps->n && ps->toks[ps->pos].type == TOK_WORD
+        && ps->toks[ps->pos+1].type == TOK_LPAREN)
+    {
+        token *name = &ps->toks[ps->pos];
+        if (!valid_name(name->start, name->len))
+        {
+            ps->pos++;
+            syntax_error(ps);
+            return 1;
+        }
+        ps->pos += 2;
+        if (ps->pos >= ps->n || ps->toks[ps->pos].type != TOK_RPAREN)
+        {
+            syntax_error(ps);
+            return 1;
+        }
+        ps->pos++;
+        skip_newlines(ps);
+
+        int is_compound = 0;
+        for (int i = 0; compound[i]; i++)
+        {
+            is_compound |= at_word(ps, compound[i]);
+        }
+        if (!is_compound)
+        {
+            syntax_error(ps);
+            return 1;
+        }
+
+        // 记录函数体原文，定义时重新解析
+        const char *start = ps->toks[ps->pos].start;
+        int doc_start = ps->doc_num;
+        if (parse_compound(ps) == NULL)
+        {
+            return 1;
+        }
+        token *last = &ps->toks[ps->pos - 1];
+
+        node *f = (node *)arena_alloc(ps->a, sizeof(node));
+        memset(f, 0, sizeof(node));
+        f->type = NODE_FUNC;
+        f->kw = "function";
+        f->name = arena_strndup(ps->a, name->start, name->len);
+        f->text = arena_strndup(ps->a, start, last->start + last->len - start);
+        f->doc_start = doc_start;
+        f->doc_num = ps->doc_num - doc_start;
+        c->body = f;
+    }
+
+    // 统计单词数
+    fixed |= c->body != NULL;
+    int max = 0;
+    for (int i = ps->pos; !fixed && i < ps->n && ps->toks[i].type == TOK_WORD; i++)
+    {
+        max++;
+    }
+    if (c->words == NULL)
+    {
+        c->words = (char **)arena_alloc(ps->a, sizeof(char *) * (max + 1));
+    }
+
+    while (ps->pos < ps->n)
+    {
+        token *t = &ps->toks[ps->pos];
+        // 重定向
+        if (is_redirect_tok(t->type))
+        {
+            redirect *r = parse_redirect(ps);
+            if (r == NULL)
+            {
+                return 1;
+            }
+            *tail = r;
+            tail = &r->next;
+        }
+        // 参数，复合指令之后只能有重定向
+        else if (t->type == TOK_WORD && !fixed)
+        {
+            if (c->argc == max)
+            {
+                max *= 2;
+                char **words = (char **)arena_alloc(ps->a, sizeof(char *) * (max + 1));
+                memcpy(words, c->words, sizeof(char *) * c->argc);
+                c->words = words;
+            }
+            c->words[c->argc++] = arena_strndup(ps->a, t->start, t->len);
+            ps->pos++;
+        }
+        else
+        {
+            break;
+        }
+    }
+    c->words[c->argc] = NULL;
+
+    // 空指令
+    if (c->argc == 0 && c->redirs == NULL && c->body == NULL)
+    {
+        syntax_error(ps);
+        return 1;
+    }
+    // 复合指令之后的单词
+    if (fixed && ps->pos < ps->n && (ps->toks[ps->pos].type == TOK_WORD || ps->toks[ps->pos].type == TOK_LPAREN))
+    {
+        syntax_error(ps);
+        return 1;
+    }
+
+    return 0;
+}
+
+// 生成重定向，here-doc的结束标记按顺序记录到ps中，失败返回NULL
+redirect *parse_redirect(parser *ps)
+{
+    token *t = &ps->toks[ps->pos];
+    ps->pos++;
+    if (ps->pos >= ps->n || ps->toks[ps->pos].type != TOK_WORD)
+    {
+        syntax_error(ps);
+        return NULL;
+    }
+
+    redirect *r = (redirect *)arena_alloc(ps->a, sizeof(redirect));
+    r->type = t->type;
+    if (t->fd >= 0)
+    {
+        r->fd = t->fd;
+    }
+    else if (r->type == TOK_GREAT || r->type == TOK_DGREAT || r->type == TOK_GREATAND)
+    {
+        r->fd = STDOUT_FILENO;
+    }
+    else
+    {
+        r->fd = STDIN_FILENO;
+    }
+    r->target = arena_strndup(ps->a, ps->toks[ps->pos].start, ps->toks[ps->pos].len);
+    r->doc = -1;
+    if (r->type == TOK_DLESS)
+    {
+        r->doc = ps->doc_num;
+        ps->docs[ps->doc_num++] = r->target;
+    }
+    r->next = NULL;
+    ps->pos++;
+
+    return r;
+}
+
+// 生成复合指令，当前单词为其关键字，失败返回NULL
+node *parse_compound(parser *ps)
+{
+    static const char *then_stops[] = {"then", NULL};
+    static const char *if_stops[] = {"elif", "else", "fi", NULL};
+    static const char *fi_stops[] = {"fi", NULL};
+    static const char *do_stops[] = {"do", NULL};
+    static const char *done_stops[] = {"done", NULL};
+    static const char *esac_stops[] = {"esac", NULL};
+    static const char *group_stops[] = {"}", NULL};
+
+    node *n = (node *)arena_alloc(ps->a, sizeof(node));
+    memset(n, 0, sizeof(node));
+    token *kw = &ps->toks[ps->pos++];
+    n->kw = arena_strndup(ps->a, kw->start, kw->len);
+
+    // 各部分的指令列表，if最多需要的数量在解析中增长
+    int cap = 2;
+    n->lists = (cmd_list **)arena_alloc(ps->a, sizeof(cmd_list *) * cap);
+
+    // if cond; then list; [elif cond; then list;]... [else list;] fi
+    if (strcmp(n->kw, "if") == 0)
+    {
+        n->type = NODE_IF;
+        int is_else = 0;
+        while (1)
+        {
+            if (n->num + 2 > cap)
+            {
+                cap *= 2;
+                cmd_list **lists = (cmd_list **)arena_alloc(ps->a, sizeof(cmd_list *) * cap);
+                memcpy(lists, n->lists, sizeof(cmd_list *) * n->num);
+                n->lists = lists;
+            }
+            if (!is_else)
+            {
+                cmd_list *cond = parse_list(ps, then_stops);
+                if (cond == NULL || ps->status != PARSE_OK || cond->num == 0 || parse_keyword(ps, "then"))
+                {
+                    syntax_error(ps);
+                    return NULL;
+                }
+                n->lists[n->num++] = cond;
+            }
+            cmd_list *body = parse_list(ps, is_else ? fi_stops : if_stops);
+            if (body == NULL || ps->status != PARSE_OK || body->num == 0)
+            {
+                syntax_error(ps);
+                return NULL;
+            }
+            n->lists[n->num++] = body;
+
+            if (is_else || at_word(ps, "fi"))
+            {
+                break;
+            }
+            if (!at_word(ps, "elif") && !at_word(ps, "else"))
+            {
+                syntax_error(ps);
+                return NULL;
+            }
+            is_else = at_word(ps, "else");
+            ps->pos++;
+        }
+        if (parse_keyword(ps, "fi"))
+        {
+            return NULL;
+        }
+    }
+    // while/until cond; do list; done
+    else if (strcmp(n->kw, "while") == 0 || strcmp(n->kw, "until") == 0)
+    {
+        n->type = n->kw[0] == 'w' ? NODE_WHILE : NODE_UNTIL;
+        cmd_list *cond = parse_list(ps, do_stops);
+        if (cond == NULL || ps->status != PARSE_OK || cond->num == 0 || parse_keyword(ps, "do"))
+        {
+            syntax_error(ps);
+            return NULL;
+        }
+        cmd_list *body = parse_list(ps, done_stops);
+        if (body == NULL || ps->status != PARSE_OK || body->num == 0 || parse_keyword(ps, "done"))
+        {
+            syntax_error(ps);
+            return NULL;
+        }
+        n->lists[0] = cond;
+        n->lists[1] = body;
+        n->num = 2;
+    }
+    // for ((init; cond; step)); do list; done，三个表达式存放在words中，name为NULL
+    else if (strcmp(n->kw, "for") == 0 && ps->pos < ps->n && ps->toks[ps->pos].type == TOK_WORD
+        && ps->toks[ps->pos].start[0] == '(')
+    {
+        n->type = NODE_FOR;
+        token *t = &ps->toks[ps->pos];
+        n->words = (char **)arena_alloc(ps->a, sizeof(char *) * 4);
+        n->word_num = 0;
+
+        // 按括号外的;分割
+        const char *start = t->start + 2;
+        const char *end = t->start + t->len - 2;
+        int depth = 0;
+        for (const char *p = start; p <= end; p++)
+        {
+            if (p < end && *p == '(')
+            {
+                depth++;
+            }
+            else if (p < end && *p == ')')
+            {
+                depth--;
+            }
+            else if (p == end || (*p == ';' && depth == 0))
+            {
+                if (n->word_num == 3)
+                {
+                    n->word_num++;
+                    break;
+                }
+                n->words[n->word_num++] = arena_strndup(ps->a, start, p - start);
+                start = p + 1;
+            }
+        }
+        if (n->word_num != 3)
+        {
+            syntax_error(ps);
+            return NULL;
+        }
+        n->words[3] = NULL;
+        ps->pos++;
+        if (ps->pos < ps->n && ps->toks[ps->pos].type == TOK_SEMI)
+        {
+            ps->pos++;
+        }
+        skip_newlines(ps);
+
+        if (parse_keyword(ps, "do"))
+        {
+            return NULL;
+        }
+        cmd_list *body = parse_list(ps, done_stops);
+        if (body == NULL || ps->status != PARSE_OK || body->num == 0 || parse_keyword(ps, "done"))
+        {
+            syntax_error(ps);
+            return NULL;
+        }
+        n->lists[0] = body;
+        n->num = 1;
+    }
+    // for name [in word...]; do list; done
+    else if (strcmp(n->kw, "for") == 0)
+    {
+        n->type = NODE_FOR;
+        if (ps->pos >= ps->n || ps->toks[ps->pos].type != TOK_WORD
+            || !valid_name(ps->toks[ps->pos].start, ps->toks[ps->pos].len))
+        {
+            syntax_error(ps);
+            return NULL;
+        }
+        n->name = arena_strndup(ps->a, ps->toks[ps->pos].start, ps->toks[ps->pos].len);
+        ps->pos++;
+        skip_newlines(ps);
+
+        if (at_word(ps, "in"))
+        {
+            ps->pos++;
+            int start = ps->pos;
+            while (ps->pos < ps->n && ps->toks[ps->pos].type == TOK_WORD)
+            {
+                ps->pos++;
+            }
+            n->word_num = ps->pos - start;
+            n->words = (char **)arena_alloc(ps->a, sizeof(char *) * (n->word_num + 1));
+            for (int i = 0; i < n->word_num; i++)
+            {
+                n->words[i] = arena_strndup(ps->a, ps->toks[start+i].start, ps->toks[start+i].len);
+            }
+            n->words[n->word_num] = NULL;
+            if (ps->pos >= ps->n || (ps->toks[ps->pos].type != TOK_SEMI && ps->toks[ps->pos].type != TOK_NEWLINE))
+            {
+                syntax_error(ps);
+                return NULL;
+            }
+            ps->pos++;
+        }
+        else if (ps->pos < ps->n && ps->toks[ps->pos].type == TOK_SEMI)
+        {
+            ps->pos++;
+        }
+        skip_newlines(ps);
+
+        if (parse_keyword(ps, "do"))
+        {
+            return NULL;
+        }
+        cmd_list *body = parse_list(ps, done_stops);
+        if (body == NULL || ps->status != PARSE_OK || body->num == 0 || parse_keyword(ps, "done"))
+        {
+            syntax_error(ps);
+            return NULL;
+        }
+        n->lists[0] = body;
+        n->num = 1;
+    }
+    // case word in [(]pattern[|pattern]...) list;; ... esac
+    else if (strcmp(n->kw, "case") == 0)
+    {
+        n->type = NODE_CASE;
+        if (ps->pos >= ps->n || ps->toks[ps->pos].type != TOK_WORD)
+        {
+            syntax_error(ps);
+            return NULL;
+        }
+        n->words = (char **)arena_alloc(ps->a, sizeof(char *) * 2);
+        n->words[0] = arena_strndup(ps->a, ps->toks[ps->pos].start, ps->toks[ps->pos].len);
+        n->words[1] = NULL;
+        n->word_num = 1;
+        ps->pos++;
+        skip_newlines(ps);
+        if (parse_keyword(ps, "in"))
+        {
+            return NULL;
+        }
+
+        n->pats = (char ***)arena_alloc(ps->a, sizeof(char **) * cap);
+        n->pat_num = (int *)arena_alloc(ps->a, sizeof(int) * cap);
+        while (1)
+        {
+            skip_newlines(ps);
+            if (at_word(ps, "esac"))
+            {
+                break;
+            }
+            if (n->num == cap)
+            {
+                cap *= 2;
+                cmd_list **lists = (cmd_list **)arena_alloc(ps->a, sizeof(cmd_list *) * cap);
+                char ***pats = (char ***)arena_alloc(ps->a, sizeof(char **) * cap);
+                int *pat_num = (int *)arena_alloc(ps->a, sizeof(int) * cap);
+                memcpy(lists, n->lists, sizeof(cmd_list *) * n->num);
+                memcpy(pats, n->pats, sizeof(char **) * n->num);
+                memcpy(pat_num, n->pat_num, sizeof(int) * n->num);
+                n->lists = lists;
+                n->pats = pats;
+                n->pat_num = pat_num;
+            }
+
+            // 模式以|分隔，以)结束
+            if (ps->pos < ps->n && ps->toks[ps->pos].type == TOK_LPAREN)
+            {
+                ps->pos++;
+            }
+            int start = ps->pos;
+            while (1)
+            {
+                if (ps->pos >= ps->n || ps->toks[ps->pos].type != TOK_WORD)
+                {
+                    syntax_error(ps);
+                    return NULL;
+                }
+                ps->pos++;
+                if (ps->pos < ps->n && ps->toks[ps->pos].type == TOK_PIPE)
+                {
+                    ps->pos++;
+                    continue;
+                }
+                if (ps->pos >= ps->n || ps->toks[ps->pos].type != TOK_RPAREN)
+                {
+                    syntax_error(ps);
+                    return NULL;
+                }
+                break;
+            }
+            int num = (ps->pos - start + 1) / 2;
+            char **pats = (char **)arena_alloc(ps->a, sizeof(char *) * num);
+            for (int i = 0; i < num; i++)
+            {
+                pats[i] = arena_strndup(ps->a, ps->toks[start+i*2].start, ps->toks[start+i*2].len);
+            }
+            ps->pos++;
+
+            cmd_list *body = parse_list(ps, esac_stops);
+            if (body == NULL || ps->status != PARSE_OK)
+            {
+                syntax_error(ps);
+                return NULL;
+            }
+            n->lists[n->num] = body;
+            n->pats[n->num] = pats;
+            n->pat_num[n->num] = num;
+            n->num++;
+
+            // 最后一项可以省略;;
+            if (ps->pos < ps->n && ps->toks[ps->pos].type == TOK_DSEMI)
+            {
+                ps->pos++;
+            }
+            else if (!at_word(ps, "esac"))
+            {
+                syntax_error(ps);
+                return NULL;
+            }
+        }
+        ps->pos++;
+    }
+    // { list; }
+    else
+    {
+        n->type = NODE_GROUP;
+        cmd_list *body = parse_list(ps, group_stops);
+        if (body == NULL || ps->status != PARSE_OK || body->num == 0 || parse_keyword(ps, "}"))
+        {
+            syntax_error(ps);
+            return NULL;
+        }
+        n->lists[0] = body;
+        n->num = 1;
+    }
+
+    return n;
+}
+
+// 生成条件指令，当前单词为整个[[ ... ]]，失败返回NULL
+// 其中的&& || ( ) < >为运算符，其余单词原样保存，求值时才展开，空单词不会丢失
+node *parse_cond(parser *ps)
+{
+    token *t = &ps->toks[ps->pos];
+    node *n = (node *)arena_alloc(ps->a, sizeof(node));
+    memset(n, 0, sizeof(node));
+    n->type = NODE_COND;
+    n->kw = "[[";
+    // 每个单词至少占一个字符
+    n->words = (char **)arena_alloc(ps->a, sizeof(char *) * (t->len + 1));
+
+    const char *c = t->start + 2;
+    const char *end = t->start + t->len - 2;
+    while (c < end)
+    {
+        const char *next;
+        if (strchr(" \t\r\n", *c))
+        {
+            c++;
+            continue;
+        }
+        if ((c[0] == '&' && c[1] == '&') || (c[0] == '|' && c[1] == '|'))
+        {
+            next = c + 2;
+        }
+        else if (strchr("()<>", *c))
+        {
+            next = c + 1;
+        }
+        else if (strchr("|&;", *c))
+        {
+            printf("syntax error near \"%c\"\n", *c);
+            ps->status = PARSE_ERROR;
+            return NULL;
+        }
+        else
+        {
+            next = lex_word(c);
+        }
+        n->words[n->word_num++] = arena_strndup(ps->a, c, next - c);
+        c = next;
+    }
+    n->words[n->word_num] = NULL;
+
+    if (n->word_num == 0)
+    {
+        printf("syntax error near \"]]\"\n");
+        ps->status = PARSE_ERROR;
+        return NULL;
+    }
+    ps->pos++;
+    return n;
+}
+
+// 当前单词为关键字kw时跳过，否则为语法错误，返回1
+int parse_keyword(parser *ps, const char *kw)
+{
+    if (at_word(ps, kw))
+    {
+        ps->pos++;
+        return 0;
+    }
+    syntax_error(ps);
+    return 1;
+}
+
+// 当前词法单元是否为单词kw
+int at_word(parser *ps, const char *kw)
+{
+    if (ps->pos >= ps->n || ps->toks[ps->pos].type != TOK_WORD)
+    {
+        return 0;
+    }
+    token *t = &ps->toks[ps->pos];
+    return (size_t)t->len == strlen(kw) && strncmp(t->start, kw, t->len) == 0;
+}
+
+// 跳过换行
+void skip_newlines(parser *ps)
+{
+    while (ps->pos < ps->n && ps->toks[ps->pos].type == TOK_NEWLINE)
+    {
+        ps->pos++;
+    }
+}
+
+// 是否为重定向符号
+int is_redirect_tok(int type)
+{
+    return type == TOK_LESS || type == TOK_GREAT || type == TOK_DGREAT || type == TOK_LESSGREAT
+        || type == TOK_LESSAND || type == TOK_GREATAND || type == TOK_DLESS || type == TOK_TLESS;
+}
+
+// 记录语法错误，只报告第一个，已到结尾时为输入未结束
+void syntax_error(parser *ps)
+{
+    if (ps->status != PARSE_OK)
+    {
+        return;
+    }
+    if (ps->pos >= ps->n)
+    {
+        ps->status = PARSE_INCOMPLETE;
+        return;
+    }
+
+    token *t = &ps->toks[ps->pos];
+    if (t->type == TOK_NEWLINE)
+    {
+        printf("syntax error near \"newline\"\n");
+    }
+    else
+    {
+        printf("syntax error near \"%.*s\"\n", t->len, t->start);
+    }
+    ps->status = PARSE_ERROR;
+}
+
+// 取得输入行的AST，相同的行只解析一次
+cmd_list *get_ast(const char *line)
+{
+    unsigned int h = hash_str(line) % AST_HASH_SIZE;
+    for (ast_entry *e = ast_hash[h]; e; e = e->next)
+    {
+        if (strcmp(e->line, line) == 0)
+        {
+            return e->list;
+        }
+    }
+
+    // 缓存已满时整体清空
+    if (ast_num >= AST_CACHE_MAX)
+    {
+        ast_clear();
+    }
+
+    ast_entry *e = (ast_entry *)malloc(sizeof(ast_entry));
+    e->mem.head = NULL;
+    e->list = parse_line(line, &e->mem);
+    // 语法错误或空行不缓存
+    if (e->list == NULL)
+    {
+        arena_free(&e->mem);
+        free(e);
+        return NULL;
+    }
+    e->line = arena_strndup(&e->mem, line, strlen(line));
+    e->next = ast_hash[h];
+    ast_hash[h] = e;
+    ast_num++;
+
+    return e->list;
+}
+
+// 清空AST缓存
+void ast_clear()
+{
+    for (int i = 0; i < AST_HASH_SIZE; i++)
+    {
+        ast_entry *e = ast_hash[i];
+        while (e)
+        {
+            ast_entry *next = e->next;
+            arena_free(&e->mem);
+            free(e);
+            e = next;
+        }
+        ast_hash[i] = NULL;
+    }
+    ast_num = 0;
+}
+
+// 初始化当前目录，$PWD与实际目录一致时直接沿用，否则调用getcwd
+void init_pwd()
+{
+    char *env_pwd = get_var("PWD");
+    struct stat st_env;
+    struct stat st_dot;
+
+    if (env_pwd && env_pwd[0] == '/' && stat(env_pwd, &st_env) == 0 && stat(".", &st_dot) == 0
+        && st_env.st_dev == st_dot.st_dev && st_env.st_ino == st_dot.st_ino)
+    {
+        shell_pwd = strdup(env_pwd);
+    }
+    else
+    {
+        shell_pwd = getcwd(NULL, 0);
+    }
+
+    if (shell_pwd)
+    {
+        export_var("PWD", shell_pwd);
+    }
+}
+
+// 取得当前目录，只有未知时才调用getcwd
+char *get_pwd()
+{
+    if (shell_pwd == NULL)
+    {
+        shell_pwd = getcwd(NULL, 0);
+        if (shell_pwd == NULL)
+        {
+            return ".";
+        }
+        export_var("PWD", shell_pwd);
+        pwd_gen++;
+    }
+
+    return shell_pwd;
+}
+
+// 更新当前目录，path为NULL表示未知
+void set_pwd(char *path)
+{
+    if (shell_pwd)
+    {
+        export_var("OLDPWD", shell_pwd);
+    }
+    free(shell_pwd);
+    shell_pwd = path;
+    if (shell_pwd)
+    {
+        export_var("PWD", shell_pwd);
+    }
+    pwd_gen++;
+}
+
+// 去掉路径中的"."、".."和多余的'/'，返回新分配的字符串
+char *normalize_path(const char *path)
+{
+    size_t len = strlen(path);
+    char *result = (char *)malloc(len + 2);
+    size_t n = 0;
+
+    const char *c = path;
+    while (*c)
+    {
+        // 跳过'/'
+        while (*c == '/')
+        {
+            c++;
+        }
+        const char *start = c;
+        while (*c && *c != '/')
+        {
+            c++;
+        }
+        size_t seg = c - start;
+
+        if (seg == 0 || (seg == 1 && start[0] == '.'))
+        {
+            continue;
+        }
+        // 返回上一级
+        if (seg == 2 && start[0] == '.' && start[1] == '.')
+        {
+            while (n > 0 && result[n-1] != '/')
+            {
+                n--;
+            }
+            if (n > 0)
+            {
+                n--;
+            }
+            continue;
+        }
+
+        result[n++] = '/';
+        memcpy(result + n, start, seg);
+        n += seg;
+    }
+
+    if (n == 0)
+    {
+        result[n++] = '/';
+    }
+    result[n] = '\0';
+
+    return result;
+}
+
+// 打印提示符，PS1及当前目录未变时直接使用缓存
+void print_prompt()
+{
+    char *ps1 = get_var("PS1");
+    if (ps1 == NULL)
+    {
+        ps1 = DEFAULT_PS1;
+    }
+
+    if (prompt_buf == NULL || prompt_dynamic || prompt_pwd_gen != pwd_gen
+        || strcmp(ps1, prompt_ps1))
+    {
+        render_prompt(ps1);
+    }
+
+    // 先输出printf缓冲的内容，再一次性写出提示符
+    fflush(stdout);
+    size_t done = 0;
+    while (done < prompt_len)
+    {
+        ssize_t n = write(STDOUT_FILENO, prompt_buf + done, prompt_len - done);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break;
+        }
+        done += n;
+    }
+}
+
+// 按PS1生成提示符
+// 支持\w \W \u \h \H \$ \n \e \\ \t \T \d，\[ \]忽略
+void render_prompt(const char *ps1)
+{
+    // 用户名及主机名
+    if (prompt_user == NULL)
+    {
+        struct passwd *pw = getpwuid(getuid());
+        prompt_user = strdup(pw ? pw->pw_name : "");
+        char host[256] = "";
+        gethostname(host, sizeof(host) - 1);
+        prompt_host = strdup(host);
+    }
+
+    free(prompt_ps1);
+    prompt_ps1 = strdup(ps1);
+    prompt_pwd_gen = pwd_gen;
+    prompt_dynamic = 0;
+
+    strbuf sb = {NULL, 0, 0};
+    for (const char *c = ps1; *c; c++)
+    {
+        if (*c != '\\' || c[1] == '\0')
+        {
+            sb_append(&sb, c, 1);
+            continue;
+        }
+
+        c++;
+        switch (*c)
+        {
+        case 'w':
+        {
+            char *pwd = get_pwd();
+            char *home = get_var("HOME");
+            size_t home_len = home ? strlen(home) : 0;
+            // 家目录缩写为~
+            if (home_len > 1 && strncmp(pwd, home, home_len) == 0
+                && (pwd[home_len] == '/' || pwd[home_len] == '\0'))
+            {
+                sb_append(&sb, "~", 1);
+                pwd += home_len;
+            }
+            sb_append(&sb, pwd, strlen(pwd));
+            break;
+        }
+        case 'W':
+        {
+            char *pwd = get_pwd();
+            char *slash = strrchr(pwd, '/');
+            if (slash && slash[1])
+            {
+                pwd = slash + 1;
+            }
+            sb_append(&sb, pwd, strlen(pwd));
+            break;
+        }
+        case 'u':
+            sb_append(&sb, prompt_user, strlen(prompt_user));
+            break;
+        case 'h':
+            sb_append(&sb, prompt_host, strcspn(prompt_host, "."));
+            break;
+        case 'H':
+            sb_append(&sb, prompt_host, strlen(prompt_host));
+            break;
+        case '$':
+            sb_append(&sb, getuid() == 0 ? "#" : "$", 1);
+            break;
+        case 'n':
+            sb_append(&sb, "\n", 1);
+            break;
+        case 'e':
+            sb_append(&sb, "\033", 1);
+            break;
+        case '\\':
+            sb_append(&sb, "\\", 1);
+            break;
+        case '[':
+        case ']':
+            break;
+        // 时间相关，每次重新生成
+        case 't':
+        case 'T':
+        case 'd':
+        {
+            char tmp[64];
+            time_t now = time(NULL);
+            struct tm *tm = localtime(&now);
+            strftime(tmp, sizeof(tmp), *c == 't' ? "%H:%M:%S" : (*c == 'T' ? "%I:%M:%S" : "%a %b %d"), tm);
+            sb_append(&sb, tmp, strlen(tmp));
+            prompt_dynamic = 1;
+            break;
+        }
+        default:
+            sb_append(&sb, c - 1, 2);
+            break;
+        }
+    }
+    sb_append(&sb, "", 0);
+
+    free(prompt_buf);
+    prompt_buf = sb.s;
+    prompt_len = sb.len;
+}
+
+// 追加内容到可增长字符串，始终以'\0'结尾
+void sb_append(strbuf *sb, const char *str, size_t len)
+{
+    if (sb->len + len + 1 > sb->cap)
+    {
+        size_t cap = sb->cap ? sb->cap : 64;
+        while (sb->len + len + 1 > cap)
+        {
+            cap *= 2;
+        }
+        sb->s = (char *)realloc(sb->s, cap);
+        sb->cap = cap;
+    }
+    memcpy(sb->s + sb->len, str, len);
+    sb->len += len;
+    sb->s[sb->len] = '\0';
+}
+
+// 处理输入，在shell进程中按连接符依次执行各管道
+// 复合指令、引号或行尾的\未结束时继续从r读取，行中有here-doc时读取正文，line随之失效
+void handle_job(char *line, reader *r)
+{
+    strbuf sb = {NULL, 0, 0};
+    sb_append(&sb, "", 0);
+    // 之前的行已读取here-doc正文
+    size_t lexed = 0;
+    cmd_list *list = NULL;
+
+    doc_bodies = NULL;
+    doc_count = 0;
+    doc_cap = 0;
+    while (1)
+    {
+        // 行尾奇数个\时续行
+        size_t len = strlen(line);
+        size_t slash = 0;
+        while (slash < len && line[len - 1 - slash] == '\\')
+        {
+            slash++;
+        }
+        sb_append(&sb, line, len - slash % 2);
+
+        if (slash % 2 == 0)
+        {
+            if (read_docs(sb.s + lexed, r) == 0)
+            {
+                lexed = sb.len;
+            }
+            list = get_ast(sb.s);
+            if (list != NULL || parse_status != PARSE_INCOMPLETE)
+            {
+                break;
+            }
+            sb_append(&sb, "\n", 1);
+        }
+
+        // 读取下一行
+        if (interactive)
+        {
+            char *ps2 = get_var("PS2");
+            printf("%s", ps2 ? ps2 : "> ");
+            fflush(stdout);
+        }
+        if ((line = read_line(r)) == NULL)
+        {
+            printf("syntax error: unexpected end of file\n");
+            parse_status = PARSE_ERROR;
+            break;
+        }
+    }
+    free(sb.s);
+
+    if (list == NULL)
+    {
+        // 语法错误，空行及注释不影响退出码
+        if (parse_status != PARSE_EMPTY)
+        {
+            last_status = 2;
+        }
+        return;
+    }
+
+    interrupted = 0;
+    run_list(list);
+}
+
+// 读取line中各here-doc的正文，直到只含结束标记的行，追加到doc_bodies
+// line中引号未结束时返回1，此时不读取
+int read_docs(const char *line, reader *r)
+{
+    token *toks;
+    int n = lex_line(line, &toks);
+    if (n < 0)
+    {
+        return 1;
+    }
+
+    for (int i = 0; i + 1 < n; i++)
+    {
+        if (toks[i].type != TOK_DLESS || toks[i+1].type != TOK_WORD)
+        {
+            continue;
+        }
+
+        // 结束标记去除引号后比较
+        char *delim = expand_word(arena_strndup(&line_arena, toks[i+1].start, toks[i+1].len), EXP_NOVARS);
+        strbuf sb = {NULL, 0, 0};
+        sb_append(&sb, "", 0);
+        while (1)
+        {
+            if (interactive)
+            {
+                printf("> ");
+                fflush(stdout);
+            }
+            char *line = read_line(r);
+            if (line == NULL)
+            {
+                printf("myshell: here-document delimited by end-of-file (wanted \"%s\")\n", delim);
+                break;
+            }
+            if (strcmp(line, delim) == 0)
+            {
+                break;
+            }
+            sb_append(&sb, line, strlen(line));
+            sb_append(&sb, "\n", 1);
+        }
+
+        if (doc_count == doc_cap)
+        {
+            doc_cap = doc_cap ? doc_cap * 2 : 4;
+            char **bodies = (char **)arena_alloc(&line_arena, sizeof(char *) * doc_cap);
+            if (doc_count > 0)
+            {
+                memcpy(bodies, doc_bodies, sizeof(char *) * doc_count);
+            }
+            doc_bodies = bodies;
+        }
+        doc_bodies[doc_count++] = arena_strndup(&line_arena, sb.s, sb.len);
+        free(sb.s);
+    }
+
+    return 0;
+}
+
+// 依次执行指令列表中的管道，按&&和||短路求值
+// break、continue、return或ctrl+c之后不再执行，返回最后的退出码
+int run_list(cmd_list *list)
+{
+    if (list->num == 0)
+    {
+        last_status = 0;
+    }
+    for (int i = 0; i < list->num && !ctl_pending(); i++)
+    {
+        if ((list->ops[i] == TOK_AND && last_status != 0) || (list->ops[i] == TOK_OR && last_status == 0))
+        {
+            continue;
+        }
+        last_status = run_pipeline(list->pls[i]);
+    }
+
+    return last_status;
+}
+
+// 在shell进程中执行复合指令，返回退出码
+int run_node(node *n)
+{
+    int status = 0;
+
+    switch (n->type)
+    {
+    // 条件成立时执行对应分支，都不成立时执行else分支
+    case NODE_IF:
+        for (int i = 0; i + 1 < n->num; i += 2)
+        {
+            run_list(n->lists[i]);
+            if (ctl_pending())
+            {
+                return last_status;
+            }
+            if (last_status == 0)
+            {
+                return run_list(n->lists[i+1]);
+            }
+        }
+        if (n->num % 2)
+        {
+            return run_list(n->lists[n->num - 1]);
+        }
+        return 0;
+
+    case NODE_WHILE:
+    case NODE_UNTIL:
+    {
+        arena_mark mark;
+        arena_get_mark(&line_arena, &mark);
+        loop_depth++;
+        while (1)
+        {
+            run_list(n->lists[0]);
+            if (loop_ctl())
+            {
+                break;
+            }
+            if ((last_status == 0) != (n->type == NODE_WHILE))
+            {
+                break;
+            }
+            int done = run_loop_body(n->lists[1], &mark);
+            status = last_status;
+            if (done)
+            {
+                break;
+            }
+        }
+        loop_depth--;
+        return status;
+    }
+
+    // 单词在循环开始前展开，没有in时为位置参数
+    case NODE_FOR:
+    {
+        if (n->name == NULL)
+        {
+            return run_arith_for(n);
+        }
+
+        char **args;
+        if (n->words != NULL)
+        {
+            command c = {n->words, n->word_num, NULL, NULL};
+            if ((args = expand_words(&c)) == NULL)
+            {
+                return 1;
+            }
+        }
+        else
+        {
+            // 循环中的set和shift会释放位置参数
+            args = (char **)arena_alloc(&line_arena, sizeof(char *) * (pos_num + 1));
+            for (int i = 0; i < pos_num; i++)
+            {
+                args[i] = arena_strndup(&line_arena, pos_args[i], strlen(pos_args[i]));
+            }
+            args[pos_num] = NULL;
+        }
+
+        arena_mark mark;
+        arena_get_mark(&line_arena, &mark);
+        loop_depth++;
+        for (int i = 0; args[i] != NULL; i++)
+        {
+            set_var(n->name, args[i]);
+            int done = run_loop_body(n->lists[0], &mark);
+            status = last_status;
+            if (done)
+            {
+                break;
+            }
+        }
+        loop_depth--;
+        return status;
+    }
+
+    // 执行第一个匹配的分支
+    case NODE_CASE:
+    {
+        char *word = expand_word(n->words[0], 0);
+        if (word == NULL)
+        {
+            return 1;
+        }
+        for (int i = 0; i < n->num; i++)
+        {
+            for (int k = 0; k < n->pat_num[i]; k++)
+            {
+                char *pat = expand_word(n->pats[i][k], 0);
+                if (pat != NULL && glob_match(pat, pat + strlen(pat), word))
+                {
+                    return run_list(n->lists[i]);
+                }
+            }
+        }
+        return 0;
+    }
+
+    case NODE_GROUP:
+        return run_list(n->lists[0]);
+
+    case NODE_COND:
+        return run_cond(n);
+
+    case NODE_FUNC:
+        define_func(n);
+        return 0;
+    }
+
+    return status;
+}
+
+// 执行for ((init; cond; step))，空的cond为真
+int run_arith_for(node *n)
+{
+    long long value;
+    if (arith_word(n->words[0], &value))
+    {
+        return 1;
+    }
+
+    int status = 0;
+    arena_mark mark;
+    arena_get_mark(&line_arena, &mark);
+    loop_depth++;
+    while (1)
+    {
+        value = 1;
+        if (n->words[1][strspn(n->words[1], " \t\n")] && arith_word(n->words[1], &value))
+        {
+            status = 1;
+            break;
+        }
+        if (value == 0)
+        {
+            break;
+        }
+        int done = run_loop_body(n->lists[0], &mark);
+        status = last_status;
+        if (done)
+        {
+            break;
+        }
+        if (arith_word(n->words[2], &value))
+        {
+            status = 1;
+            break;
+        }
+    }
+    loop_depth--;
+    return status;
+}
+
+// 执行一轮循环体，回收本轮在line_arena中分配的内存，需要退出循环时返回1
+int run_loop_body(cmd_list *body, arena_mark *mark)
+{
+    run_list(body);
+    glob_cache_clear();
+    arena_release(&line_arena, mark);
+    return loop_ctl();
+}
+
+// 处理循环中的break和continue，每层循环消耗一层，需要退出循环时返回1
+int loop_ctl()
+{
+    if (loop_break > 0)
+    {
+        loop_break--;
+        return 1;
+    }
+    if (loop_cont > 0)
+    {
+        return --loop_cont > 0;
+    }
+
+    return func_return || interrupted;
+}
+
+// 是否有尚未处理的break、continue、return或ctrl+c
+int ctl_pending()
+{
+    return loop_break || loop_cont || func_return || interrupted;
+}
+
+// 查找函数，不存在返回NULL
+func *find_func(const char *name)
+{
+    for (func *f = func_hash[hash_str(name) % FUNC_HASH_SIZE]; f; f = f->next)
+    {
+        if (strcmp(f->name, name) == 0)
+        {
+            return f;
+        }
+    }
+    return NULL;
+}
+
+// 定义函数，函数体原文重新解析到函数自己的内存池，并复制其中here-doc的正文
+// 同名函数正在执行时推迟到调用结束后释放
+void define_func(node *n)
+{
+    func *f = (func *)malloc(sizeof(func));
+    f->mem.head = NULL;
+    f->body = parse_line(n->text, &f->mem);
+    if (f->body == NULL)
+    {
+        free_func(f);
+        return;
+    }
+    f->name = arena_strndup(&f->mem, n->name, strlen(n->name));
+    f->docs = (char **)arena_alloc(&f->mem, sizeof(char *) * (n->doc_num + 1));
+    for (int i = 0; i < n->doc_num; i++)
+    {
+        char *body = doc_bodies[n->doc_start + i];
+        f->docs[i] = arena_strndup(&f->mem, body, strlen(body));
+    }
+    f->refs = 0;
+    f->dead = 0;
+
+    func **pf = &func_hash[hash_str(f->name) % FUNC_HASH_SIZE];
+    for (; *pf; pf = &(*pf)->next)
+    {
+        if (strcmp((*pf)->name, f->name) == 0)
+        {
+            func *old = *pf;
+            *pf = old->next;
+            old->dead = 1;
+            if (old->refs == 0)
+            {
+                free_func(old);
+            }
+            break;
+        }
+    }
+    f->next = func_hash[hash_str(f->name) % FUNC_HASH_SIZE];
+    func_hash[hash_str(f->name) % FUNC_HASH_SIZE] = f;
+}
+
+// 释放函数
+void free_func(func *f)
+{
+    arena_free(&f->mem);
+    free(f);
+}
+
+// 调用函数，args[1]...作为位置参数，返回退出码
+// 调用期间保存调用者的位置参数、here-doc正文及循环层数，返回时恢复local声明的变量
+int call_func(func *f, char **args)
+{
+    if (func_depth >= FUNC_DEPTH_MAX)
+    {
+        printf("%s: maximum function nesting level exceeded (%d)\n", f->name, FUNC_DEPTH_MAX);
+        return 1;
+    }
+
+    char **saved_args = pos_args;
+    int saved_num = pos_num;
+    pos_args = NULL;
+    pos_num = 0;
+    int num = 0;
+    while (args[num + 1] != NULL)
+    {
+        num++;
+    }
+    set_pos_args(args + 1, num);
+
+    char **saved_docs = doc_bodies;
+    int saved_depth = loop_depth;
+    doc_bodies = f->docs;
+    loop_depth = 0;
+    frame fr = {NULL, cur_frame};
+    cur_frame = &fr;
+    func_depth++;
+    f->refs++;
+
+    int status = run_list(f->body);
+    if (func_return)
+    {
+        status = return_status;
+        func_return = 0;
+    }
+
+    // 后声明的先恢复
+    while (fr.locals != NULL)
+    {
+        local_var *l = fr.locals;
+        fr.locals = l->next;
+        if (l->value == NULL)
+        {
+            unset_var(l->name);
+        }
+        else if (l->exported)
+        {
+            export_var(l->name, l->value);
+        }
+        else
+        {
+            set_var(l->name, l->value);
+        }
+        free(l->name);
+        free(l->value);
+        free(l);
+    }
+
+    if (--f->refs == 0 && f->dead)
+    {
+        free_func(f);
+    }
+    func_depth--;
+    cur_frame = fr.prev;
+    loop_depth = saved_depth;
+    doc_bodies = saved_docs;
+    for (int i = 0; i < pos_num; i++)
+    {
+        free(pos_args[i]);
+    }
+    free(pos_args);
+    pos_args = saved_args;
+    pos_num = saved_num;
+
+    return status;
+}
+
+// 执行单个管道，返回退出码
+int run_pipeline(pipeline *pl)
+{
+    int status = 0;
+    command *first = &pl->cmds[0];
+
+    if (first->argc == 0 && first->body == NULL)
+    {
+        set_pipe_status(&status, 1);
+        return 0;
+    }
+
+    // 检查是否为build in指令，单独的复合指令及函数同样在shell进程中执行
+    if (pl->is_parent || (pl->num == 1 && !pl->is_bg && (first->body != NULL || find_func(first->words[0]) != NULL)))
+    {
+        // 循环中的每条指令都经过这里，只在需要计时时才取得资源使用
+        struct timespec start, end;
+        struct rusage before, after;
+        if (pl->is_timed)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            getrusage(RUSAGE_SELF, &before);
+        }
+
+        status = run_buildin(&pl->cmds[0], STDIN_FILENO);
+        set_pipe_status(&status, 1);
+
+        // 在shell进程中执行，耗时按shell自身的资源使用计算
+        if (pl->is_timed)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            getrusage(RUSAGE_SELF, &after);
+            after.ru_utime.tv_sec -= before.ru_utime.tv_sec;
+            after.ru_utime.tv_usec -= before.ru_utime.tv_usec;
+            after.ru_stime.tv_sec -= before.ru_stime.tv_sec;
+            after.ru_stime.tv_usec -= before.ru_stime.tv_usec;
+            print_time_usage(ts_diff(&end, &start), &after);
+        }
+    }
+    else
+    {
+        // 启动期间屏蔽信号，避免fork出的子进程在恢复默认处理前写入self-pipe
+        sigset_t mask, old_mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGCHLD);
+        sigaddset(&mask, SIGINT);
+        sigaddset(&mask, SIGTSTP);
+        sigprocmask(SIG_BLOCK, &mask, &old_mask);
+
+        // 创建管道，num个阶段只需num-1个管道
+        int num = pl->num;
+        int (*pipe_fd)[2] = arena_alloc(&line_arena, sizeof(int[2]) * num);
+        for (int i = 0; i < num - 1; i++)
+        {
+            if (pipe(pipe_fd[i]))
+            {
+                printf("pipe error\n");
+                for (int k = 0; k < i; k++)
+                {
+                    close(pipe_fd[k][0]);
+                    close(pipe_fd[k][1]);
+                }
+                sigprocmask(SIG_SETMASK, &old_mask, NULL);
+                return 1;
+            }
+        }
+
+        // shell直接启动各阶段，作业控制时整个管道为一个进程组
+        // 脚本、-c及子shell中没有作业控制，各阶段留在shell的进程组，否则读取终端时会被SIGTTIN暂停
+        pid_t *pids = (pid_t *)arena_alloc(&line_arena, sizeof(pid_t) * num);
+        int *stage = (int *)arena_alloc(&line_arena, sizeof(int) * num);
+        pid_t pgid = job_control ? 0 : -1;
+        int last_in_parent = 0;
+        fflush(stdout);
+        for (int i = 0; i < num; i++)
+        {
+            int in_fd = (i != 0) ? pipe_fd[i-1][0] : STDIN_FILENO;
+            int out_fd = (i != (num-1)) ? pipe_fd[i][1] : STDOUT_FILENO;
+            command *c = &pl->cmds[i];
+            const buildin *b = NULL;
+            if (!pl->is_bg && c->argc > 0 && find_func(c->words[0]) == NULL)
+            {
+                b = get_cmd(c->words[0]);
+            }
+
+            // 未启动进程的阶段pid记为-1，启动失败视为找不到指令，重定向失败退出码为1
+            pids[i] = -1;
+            stage[i] = 127;
+
+            // 最后一个阶段为build in指令时，在其余阶段启动后由shell进程执行
+            if (i == num - 1 && b != NULL && (b->flags & (BI_PARENT | BI_PIPE)))
+            {
+                last_in_parent = 1;
+                continue;
+            }
+            // 只输出结果的build in指令在shell进程中执行，只在写不进管道时fork
+            if (b != NULL && (b->flags & BI_PIPE) && !(b->flags & BI_PARENT) && c->redirs == NULL)
+            {
+                pids[i] = run_buildin_pipe(c, out_fd, pipe_fd, num - 1, pgid, !pl->is_bg, &stage[i]);
+            }
+            else
+            {
+                pids[i] = do_cmd(c, in_fd, out_fd, pipe_fd, num - 1, pgid, !pl->is_bg);
+            }
+            if (pids[i] == PID_NOT_RUN)
+            {
+                stage[i] = 1;
+                pids[i] = -1;
+            }
+            if (pids[i] < 0)
+            {
+                continue;
+            }
+
+            // 父进程同样设置，避免与子进程竞争
+            if (pgid == 0)
+            {
+                pgid = pids[i];
+                if (job_control && !pl->is_bg)
+                {
+                    tcsetpgrp(STDIN_FILENO, pgid);
+                }
+            }
+            if (pgid > 0)
+            {
+                setpgid(pids[i], pgid);
+            }
+        }
+
+        // 全部启动后再登记为一个job，fork出的子进程看不到自己
+        job *j = add_job(pl->text, num, !pl->is_bg);
+        for (int i = 0; i < num; i++)
+        {
+            if (pids[i] > 0)
+            {
+                command *c = &pl->cmds[i];
+                add_proc(j, i, pids[i], c->body ? c->body->kw : c->words[0]);
+            }
+            else
+            {
+                j->procs[i].exit_status = stage[i];
+            }
+        }
+
+        // 父进程关闭全部管道，否则读端永远等不到EOF
+        // 在shell进程中执行的最后一个阶段仍需读端
+        for (int i = 0; i < num - 1; i++)
+        {
+            if (!(last_in_parent && i == num - 2))
+            {
+                close(pipe_fd[i][0]);
+            }
+            close(pipe_fd[i][1]);
+        }
+        sigprocmask(SIG_SETMASK, &old_mask, NULL);
+
+        if (last_in_parent)
+        {
+            j->busy = 1;
+            stage[num - 1] = run_buildin(&pl->cmds[num - 1], pipe_fd[num - 2][0]);
+            j->busy = 0;
+            close(pipe_fd[num - 2][0]);
+            j->procs[num - 1].exit_status = stage[num - 1];
+            if (j->status == STAT_DONE)
+            {
+                j->exit_status = stage[num - 1];
+            }
+        }
+
+        // 没有需要等待的进程
+        if (j->pid == 0)
+        {
+            set_pipe_status(stage, num);
+            del_job(j);
+            return stage[num - 1];
+        }
+
+        // 背景执行
+        if (pl->is_bg)
+        {
+            print_job_info(j);
+            set_pipe_status(&status, 1);
+        }
+        // 前景执行
+        else
+        {
+            status = wait_fg(j, pl->is_timed);
+        }
+    }
+
+    return status;
+}
+
+// 记录各阶段退出码
+void set_pipe_status(int *status, int num)
+{
+    if (num > pipe_status_num)
+    {
+        pipe_status = (int *)realloc(pipe_status, sizeof(int) * num);
+    }
+    memcpy(pipe_status, status, sizeof(int) * num);
+    pipe_status_num = num;
+}
+
+// 新增job，num个阶段均未启动
+job *add_job(char *cmd, int num, int fg)
+{
+    job *new_job = (job *)malloc(sizeof(job));
+    new_job->job_num = cur_job_num++;
+    new_job->pid = 0;
+    new_job->status = STAT_RUNNING;
+    new_job->is_fg = fg;
+    new_job->busy = 0;
+    new_job->exit_status = 0;
+    new_job->has_tmodes = 0;
+    clock_gettime(CLOCK_MONOTONIC, &new_job->start);
+    new_job->end = new_job->start;
+    memset(&new_job->usage, 0, sizeof(new_job->usage));
+    new_job->cmd = intern_str(cmd);
+
+    new_job->procs = (proc *)malloc(sizeof(proc) * num);
+    new_job->proc_num = num;
+    for (int i = 0; i < num; i++)
+    {
+        new_job->procs[i].pid = -1;
+        new_job->procs[i].name = NULL;
+        new_job->procs[i].status = STAT_DONE;
+        new_job->procs[i].exit_status = 127;
+        new_job->procs[i].j = new_job;
+        new_job->procs[i].next = NULL;
+    }
+
+    // 加入链表尾
+    new_job->prev = job_tail;
+    new_job->next = NULL;
+    if (job_tail)
+    {
+        job_tail->next = new_job;
+    }
+    else
+    {
+        job_head = new_job;
+    }
+    job_tail = new_job;
+
+    // 加入索引
+    unsigned int h = (unsigned int)new_job->job_num % JOB_HASH_SIZE;
+    new_job->num_next = job_num_hash[h];
+    job_num_hash[h] = new_job;
+
+    if (fg)
+    {
+        fg_job = new_job;
+    }
+
+    return new_job;
+}
+
+// 记录已启动的第i个阶段，第一个启动的阶段为进程组长
+void add_proc(job *j, int i, pid_t pid, const char *name)
+{
+    proc *p = &j->procs[i];
+    p->pid = pid;
+    p->name = intern_str(name ? name : "");
+    p->status = STAT_RUNNING;
+    p->exit_status = 0;
+
+    unsigned int h = (unsigned int)pid % JOB_HASH_SIZE;
+    p->next = job_pid_hash[h];
+    job_pid_hash[h] = p;
+
+    if (j->pid == 0)
+    {
+        j->pid = pid;
+    }
+}
+
+// 阶段结束，累加资源使用，报告异常终止
+void proc_exit(proc *p, int status, struct rusage *usage)
+{
+    job *j = p->j;
+
+    p->status = STAT_DONE;
+    p->exit_status = get_exit_status(status);
+
+    j->usage.ru_utime.tv_sec += usage->ru_utime.tv_sec;
+    j->usage.ru_utime.tv_usec += usage->ru_utime.tv_usec;
+    j->usage.ru_stime.tv_sec += usage->ru_stime.tv_sec;
+    j->usage.ru_stime.tv_usec += usage->ru_stime.tv_usec;
+    if (usage->ru_maxrss > j->usage.ru_maxrss)
+    {
+        j->usage.ru_maxrss = usage->ru_maxrss;
+    }
+
+    // SIGINT与SIGPIPE属正常情形
+    if (WIFSIGNALED(status) && WTERMSIG(status) != SIGINT && WTERMSIG(status) != SIGPIPE)
+    {
+        printf("[%d] %s: %s\n", (int)(p - j->procs) + 1, p->name, strsignal(WTERMSIG(status)));
+    }
+}
+
+// 由各阶段的状态计算job状态
+void update_job(job *j)
+{
+    int running = 0;
+    int stopped = 0;
+    for (int i = 0; i < j->proc_num; i++)
+    {
+        if (j->procs[i].status == STAT_RUNNING)
+        {
+            running++;
+        }
+        else if (j->procs[i].status == STAT_SUSPENDED)
+        {
+            stopped++;
+        }
+    }
+
+    // 全部结束，退出码为最后一个阶段的退出码
+    if (running == 0 && stopped == 0)
+    {
+        if (j->status != STAT_DONE)
+        {
+            j->status = STAT_DONE;
+            j->exit_status = j->procs[j->proc_num - 1].exit_status;
+            clock_gettime(CLOCK_MONOTONIC, &j->end);
+        }
+    }
+    // 其余阶段全部暂停
+    else if (running == 0)
+    {
+        j->status = STAT_SUSPENDED;
+        j->is_fg = 0;
+        if (fg_job == j)
+        {
+            fg_job = NULL;
+        }
+    }
+    else if (j->status == STAT_SUSPENDED)
+    {
+        j->status = STAT_CONTINUED;
+    }
+}
+
+// 删除job
+void del_job(job *j)
+{
+    if (j->prev)
+    {
+        j->prev->next = j->next;
+    }
+    else
+    {
+        job_head = j->next;
+    }
+    if (j->next)
+    {
+        j->next->prev = j->prev;
+    }
+    else
+    {
+        job_tail = j->prev;
+    }
+
+    for (int i = 0; i < j->proc_num; i++)
+    {
+        proc *p = &j->procs[i];
+        if (p->pid < 0)
+        {
+            continue;
+        }
+        proc **pp = &job_pid_hash[(unsigned int)p->pid % JOB_HASH_SIZE];
+        while (*pp != p)
+        {
+            pp = &(*pp)->next;
+        }
+        *pp = p->next;
+        release_str(p->name);
+    }
+    free(j->procs);
+
+    job **p = &job_num_hash[(unsigned int)j->job_num % JOB_HASH_SIZE];
+    while (*p != j)
+    {
+        p = &(*p)->num_next;
+    }
+    *p = j->num_next;
+
+    if (fg_job == j)
+    {
+        fg_job = NULL;
+    }
+
+    // 从剩余job的最大编号之后继续编号，没有job时从1开始
+    cur_job_num = job_tail ? job_tail->job_num + 1 : 1;
+
+    release_str(j->cmd);
+    free(j);
+}
+
+// 以pid查找管道阶段
+proc *find_proc(pid_t pid)
+{
+    for (proc *p = job_pid_hash[(unsigned int)pid % JOB_HASH_SIZE]; p; p = p->next)
+    {
+        if (p->pid == pid)
+        {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+// 以任一阶段的pid查找job
+job *find_job_pid(pid_t pid)
+{
+    proc *p = find_proc(pid);
+    return p ? p->j : NULL;
+}
+
+// 以job编号查找job
+job *find_job_num(int num)
+{
+    for (job *j = job_num_hash[(unsigned int)num % JOB_HASH_SIZE]; j; j = j->num_next)
+    {
+        if (j->job_num == num)
+        {
+            return j;
+        }
+    }
+    return NULL;
+}
+
+// 以%job编号或pid参数查找job，供fg、bg及wait使用，正在执行最后一个阶段的job视为不存在
+job *find_job(char *name, char *arg)
+{
+    job *j;
+
+    if (arg == NULL)
+    {
+        printf("%s: missing argument\n", name);
+        return NULL;
+    }
+
+    // job number
+    if (arg[0] == '%')
+    {
+        if ((j = find_job_num(atoi(arg + 1))) == NULL || j->busy)
+        {
+            printf("%s: error job number: %s\n", name, arg + 1);
+            return NULL;
+        }
+        return j;
+    }
+
+    // pid
+    pid_t pid = atoi(arg);
+    if (pid <= 0)
+    {
+        printf("%s: error pid: %s\n", name, arg);
+        return NULL;
+    }
+    if ((j = find_job_pid(pid)) == NULL || j->busy)
+    {
+        printf("%s: process didn't exist, pid: %s\n", name, arg);
+        return NULL;
+    }
+    return j;
+}
+
+// job是否仍在运行
+int job_pending(job *j)
+{
+    return j->status == STAT_RUNNING || j->status == STAT_CONTINUED;
+}
+
+// 取得驻留字符串，相同内容只保存一份
+const char *intern_str(const char *str)
+{
+    unsigned int h = hash_str(str) % INTERN_HASH_SIZE;
+    for (intern_entry *e = intern_hash[h]; e; e = e->next)
+    {
+        if (strcmp(e->str, str) == 0)
+        {
+            e->refs++;
+            return e->str;
+        }
+    }
+
+    intern_entry *e = (intern_entry *)malloc(sizeof(intern_entry));
+    e->str = strdup(str);
+    e->refs = 1;
+    e->next = intern_hash[h];
+    intern_hash[h] = e;
+    return e->str;
+}
+
+// 释放驻留字符串，没有引用时删除
+void release_str(const char *str)
+{
+    intern_entry **p = &intern_hash[hash_str(str) % INTERN_HASH_SIZE];
+    for (; *p; p = &(*p)->next)
+    {
+        intern_entry *e = *p;
+        if (e->str == str)
+        {
+            if (--e->refs == 0)
+            {
+                *p = e->next;
+                free(e->str);
+                free(e);
+            }
+            return;
+        }
+    }
+}
+
+// 打印job信息
+void print_job_info(job *j)
+{
+    // job状态
+    char *stat[STAT_NUM];
+    stat[STAT_RUNNING] = "RUNNING";
+    stat[STAT_DONE] = "DONE";
+    stat[STAT_SUSPENDED] = "SUSPENDED";
+    stat[STAT_CONTINUED] = "CONTINUED";
+    stat[STAT_TERMINATED] = "TERMINATED";
+
+    printf("[%d]\t%s\t\t%s\n", j->job_num, stat[j->status], j->cmd);
+}
+
+// 打印job的耗时及资源使用，运行中的job只有已经过的时间
+void print_job_usage(job *j)
+{
+    char *stat[STAT_NUM];
+    stat[STAT_RUNNING] = "RUNNING";
+    stat[STAT_DONE] = "DONE";
+    stat[STAT_SUSPENDED] = "SUSPENDED";
+    stat[STAT_CONTINUED] = "CONTINUED";
+    stat[STAT_TERMINATED] = "TERMINATED";
+
+    struct timespec now;
+    if (j->status == STAT_DONE)
+    {
+        now = j->end;
+    }
+    else
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    }
+
+    printf("[%d]\t%s\treal %.3fs user %.3fs sys %.3fs maxrss %ldK\t%s\n",
+        j->job_num, stat[j->status], ts_diff(&now, &j->start),
+        tv_sec(&j->usage.ru_utime), tv_sec(&j->usage.ru_stime),
+        j->usage.ru_maxrss, j->cmd);
+}
+
+// 计算时间差(秒)
+double ts_diff(struct timespec *end, struct timespec *start)
+{
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// timeval转为秒
+double tv_sec(struct timeval *tv)
+{
+    return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+// time关键字的输出，格式与bash相同，另加最大常驻内存
+void print_time_usage(double real, struct rusage *ru)
+{
+    double user = tv_sec(&ru->ru_utime);
+    double sys = tv_sec(&ru->ru_stime);
+
+    fflush(stdout);
+    fprintf(stderr, "\nreal\t%dm%.3fs\n", (int)(real / 60), real - (int)(real / 60) * 60);
+    fprintf(stderr, "user\t%dm%.3fs\n", (int)(user / 60), user - (int)(user / 60) * 60);
+    fprintf(stderr, "sys\t%dm%.3fs\n", (int)(sys / 60), sys - (int)(sys / 60) * 60);
+    fprintf(stderr, "maxrss\t%ldK\n", ru->ru_maxrss);
+}
+
+// 在shell进程中执行build in指令、复合指令或函数
+// in_fd不是标准输入时接到标准输入，执行后恢复被重定向的fd
+int run_buildin(command *c, int in_fd)
+{
+    char **args = NULL;
+
+    // 环境变量替换，复合指令的单词在执行时展开
+    if (c->body == NULL && (args = expand_words(c)) == NULL)
+    {
+        return 1;
+    }
+
+    // 运行指令
+    int status = 1;
+    int (*saved)[2];
+    int num;
+    if (push_redirect(c->redirs, in_fd, &saved, &num) == 0)
+    {
+        func *f;
+        if (c->body != NULL)
+        {
+            status = run_node(c->body);
+        }
+        else if (args[0] == NULL)
+        {
+            status = 0;
+        }
+        else if ((f = find_func(args[0])) != NULL)
+        {
+            status = call_func(f, args);
+        }
+        else
+        {
+            status = handle_cmd(args);
+        }
+    }
+    pop_redirect(saved, num);
+
+    return status;
+}
+
+// 在shell进程中设置重定向，被替换的fd保存到saved中，num为其数量
+// in_fd不是标准输入时先连接到标准输入，重定向失败返回1，此时仍需pop_redirect恢复
+int push_redirect(redirect *r, int in_fd, int (**saved)[2], int *num)
+{
+    int max = 1;
+    for (redirect *p = r; p; p = p->next)
+    {
+        max++;
+    }
+    *saved = arena_alloc(&line_arena, sizeof(int[2]) * max);
+    int n = 0;
+    *num = 0;
+
+    // 没有需要替换的fd
+    if (r == NULL && in_fd == STDIN_FILENO)
+    {
+        return 0;
+    }
+
+    fflush(stdout);
+    if (in_fd != STDIN_FILENO && !redirect_covers(r, STDIN_FILENO))
+    {
+        (*saved)[n][0] = STDIN_FILENO;
+        (*saved)[n][1] = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 10);
+        n++;
+        dup2(in_fd, STDIN_FILENO);
+    }
+    for (redirect *p = r; p; p = p->next)
+    {
+        (*saved)[n][0] = p->fd;
+        (*saved)[n][1] = fcntl(p->fd, F_DUPFD_CLOEXEC, 10);
+        n++;
+    }
+    *num = n;
+    for (int i = 0; i < n; i++)
+    {
+        stdin_pushed += (*saved)[i][0] == STDIN_FILENO;
+    }
+
+    return handle_redirect(r) != 0;
+}
+
+// 按相反顺序恢复push_redirect保存的fd
+void pop_redirect(int (*saved)[2], int num)
+{
+    if (num == 0)
+    {
+        return;
+    }
+    fflush(stdout);
+    while (num-- > 0)
+    {
+        stdin_pushed -= saved[num][0] == STDIN_FILENO;
+        if (saved[num][1] >= 0)
+        {
+            dup2(saved[num][1], saved[num][0]);
+            close(saved[num][1]);
+        }
+        else
+        {
+            close(saved[num][0]);
+        }
+    }
+}
+
+// 在shell进程中执行管道中的build in指令，输出先写入内存再写入管道
+// 管道容纳不下时才fork子进程写出剩余部分，返回其pid，否则返回-1
+pid_t run_buildin_pipe(command *c, int out_fd, int (*pipe_fd)[2], int pipe_num, pid_t pgid, int fg, int *status)
+{
+    char **args = expand_words(c);
+    if (args == NULL)
+    {
+        *status = 1;
+        return -1;
+    }
+
+    // 暂时以内存流代替stdout
+    char *buf = NULL;
+    size_t len = 0;
+    FILE *out = open_memstream(&buf, &len);
+    if (out == NULL)
+    {
+        return do_cmd(c, STDIN_FILENO, out_fd, pipe_fd, pipe_num, pgid, fg);
+    }
+    fflush(stdout);
+    FILE *saved = stdout;
+    stdout = out;
+    *status = handle_cmd(args);
+    stdout = saved;
+    fclose(out);
+
+    // 非阻塞写入，读端已关闭时忽略
+    int flags = fcntl(out_fd, F_GETFL);
+    fcntl(out_fd, F_SETFL, flags | O_NONBLOCK);
+    size_t done = 0;
+    while (done < len)
+    {
+        ssize_t got = write(out_fd, buf + done, len - done);
+        if (got < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (got <= 0)
+        {
+            break;
+        }
+        done += got;
+    }
+    fcntl(out_fd, F_SETFL, flags);
+
+    pid_t pid = -1;
+    if (done < len && errno == EAGAIN)
+    {
+        fflush(stdout);
+        if ((pid = fork()) == 0)
+        {
+            init_child(pgid, fg);
+            for (int j = 0; j < pipe_num; j++)
+            {
+                close(pipe_fd[j][0]);
+                if (pipe_fd[j][1] != out_fd)
+                {
+                    close(pipe_fd[j][1]);
+                }
+            }
+            while (done < len)
+            {
+                ssize_t got = write(out_fd, buf + done, len - done);
+                if (got < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (got <= 0)
+                {
+                    break;
+                }
+                done += got;
+            }
+            exit(*status);
+        }
+    }
+
+    free(buf);
+    return pid;
+}
+
+// 转换waitpid状态为退出码，被信号终止时为128+信号编号
+int get_exit_status(int status)
+{
+    if (WIFEXITED(status))
+    {
+        return WEXITSTATUS(status);
+    }
+    if (WIFSIGNALED(status))
+    {
+        return 128 + WTERMSIG(status);
+    }
+
+    return 0;
+}
+
+// 启动管道中的一个阶段，返回子进程pid，失败返回-1
+// build in指令、复合指令及函数fork后在子进程执行，外部指令由posix_spawn启动
+pid_t do_cmd(command *c, int in_fd, int out_fd, int (*pipe_fd)[2], int pipe_num, pid_t pgid, int fg)
+{
+    pid_t pid = -1;
+    char **args = NULL;
+    func *f = NULL;
+
+    // 环境变量替换，复合指令的单词在子进程中展开
+    if (c->body == NULL)
+    {
+        args = expand_words(c);
+        if (args == NULL)
+        {
+            return PID_NOT_RUN;
+        }
+        if (args[0] == NULL)
+        {
+            return -1;
+        }
+
+        // 外部指令
+        f = find_func(args[0]);
+        if (f == NULL && get_cmd(args[0]) == NULL)
+        {
+            return spawn_cmd(c, args, in_fd, out_fd, pipe_fd, pipe_num, pgid);
+        }
+    }
+
+    // 子进程可能读取同一输入
+    if (in_fd == STDIN_FILENO)
+    {
+        sync_reader(shell_input);
+    }
+
+    // build in指令，清空输出缓冲，避免子进程重复输出
+    fflush(stdout);
+    if ((pid = fork()) < 0)
+    {
+        printf("fork error\n");
+    }
+    else if (pid == 0)
+    {
+        init_child(pgid, fg);
+
+        // 被重定向覆盖的fd不再dup2
+        if (in_fd != STDIN_FILENO && !redirect_covers(c->redirs, STDIN_FILENO))
+        {
+            dup2(in_fd, STDIN_FILENO);
+        }
+        if (out_fd != STDOUT_FILENO && !redirect_covers(c->redirs, STDOUT_FILENO))
+        {
+            dup2(out_fd, STDOUT_FILENO);
+        }
+
+        // 关闭文件
+        for (int j = 0; j < pipe_num; j++)
+        {
+            close(pipe_fd[j][0]);
+            close(pipe_fd[j][1]);
+        }
+
+        // 重定向处理
+        if (handle_redirect(c->redirs))
+        {
+            exit(1);
+        }
+        // 复合指令及函数由子shell执行
+        if (c->body != NULL || f != NULL)
+        {
+            init_subshell();
+            exit(c->body != NULL ? run_node(c->body) : call_func(f, args));
+        }
+        // 运行指令
+        exit(handle_cmd(args));
+    }
+
+    return pid;
+}
+
+// 启动外部指令
+// posix_spawn在glibc中以vfork方式创建子进程，无需复制父进程的页表
+pid_t spawn_cmd(command *c, char **args, int in_fd, int out_fd, int (*pipe_fd)[2], int pipe_num, pid_t pgid)
+{
+    pid_t pid = -1;
+    char path[PATH_MAX];
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+
+    // 连接管道，被重定向覆盖的fd不再dup2
+    if (in_fd != STDIN_FILENO && !redirect_covers(c->redirs, STDIN_FILENO))
+    {
+        posix_spawn_file_actions_adddup2(&actions, in_fd, STDIN_FILENO);
+    }
+    if (out_fd != STDOUT_FILENO && !redirect_covers(c->redirs, STDOUT_FILENO))
+    {
+        posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+    }
+    for (int j = 0; j < pipe_num; j++)
+    {
+        posix_spawn_file_actions_addclose(&actions, pipe_fd[j][0]);
+        posix_spawn_file_actions_addclose(&actions, pipe_fd[j][1]);
+    }
+
+    // 重定向处理，记录打开的fd以便启动后关闭
+    int num = 1;
+    for (redirect *r = c->redirs; r; r = r->next)
+    {
+        num++;
+    }
+    int *fds = arena_alloc(&line_arena, sizeof(int) * num);
+    int err = spawn_redirect(c->redirs, &actions, fds);
+    if (err)
+    {
+        for (int j = 0; fds[j] >= 0; j++)
+        {
+            close(fds[j]);
+        }
+        posix_spawn_file_actions_destroy(&actions);
+        return PID_NOT_RUN;
+    }
+
+    // 子进程恢复默认信号处理
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t mask;
+    sigemptyset(&mask);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGQUIT);
+    sigaddset(&mask, SIGTSTP);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGTTIN);
+    sigaddset(&mask, SIGTTOU);
+    sigaddset(&mask, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &mask);
+    short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+    // 加入job的进程组，pgid为0时自成一组，小于0时留在shell的进程组
+    if (pgid >= 0)
+    {
+        posix_spawnattr_setpgroup(&attr, pgid);
+        flags |= POSIX_SPAWN_SETPGROUP;
+    }
+    posix_spawnattr_setflags(&attr, flags);
+
+    char **argv = args;
+
+    // 子进程可能读取同一输入
+    if (in_fd == STDIN_FILENO && !redirect_covers(c->redirs, STDIN_FILENO))
+    {
+        sync_reader(shell_input);
+    }
+
+    // 查找指令路径
+    if (find_cmd(argv[0], path, sizeof(path)))
+    {
+        error_cmd(args);
+    }
+    else
+    {
+        int err = posix_spawn(&pid, path, &actions, &attr, argv, get_envp());
+        // 缓存的路径已不存在，删除后重新查找
+        if (err == ENOENT && strchr(argv[0], '/') == NULL)
+        {
+            path_hash_del(argv[0]);
+            if (find_cmd(argv[0], path, sizeof(path)) == 0)
+            {
+                err = posix_spawn(&pid, path, &actions, &attr, argv, get_envp());
+            }
+        }
+        if (err)
+        {
+            printf("%s: %s\n", argv[0], strerror(err));
+            pid = -1;
+        }
+    }
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    for (int j = 0; fds[j] >= 0; j++)
+    {
+        close(fds[j]);
+    }
+
+    return pid;
+}
+
+// fork出的子进程恢复默认信号处理，加入job的进程组
+// pgid为0时自成一组，小于0时留在shell的进程组，fg时取得终端
+void init_child(pid_t pgid, int fg)
+{
+    signal(SIGINT, SIG_DFL);
+    signal(SIGQUIT, SIG_DFL);
+    signal(SIGTSTP, SIG_DFL);
+    signal(SIGCHLD, SIG_DFL);
+    signal(SIGPIPE, SIG_DFL);
+    close(sig_pipe[0]);
+    close(sig_pipe[1]);
+    sig_pipe[0] = sig_pipe[1] = -1;
+
+    if (pgid >= 0)
+    {
+        setpgid(0, pgid);
+        // 此时SIGTTOU仍被忽略
+        if (job_control && fg && pgid == 0)
+        {
+            tcsetpgrp(STDIN_FILENO, getpid());
+        }
+    }
+    signal(SIGTTIN, SIG_DFL);
+    signal(SIGTTOU, SIG_DFL);
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigprocmask(SIG_SETMASK, &mask, NULL);
+}
+
+// fork出的子进程作为子shell继续解释执行，不再进行作业控制
+// 重新建立self-pipe以等待自己启动的进程，ctrl+c和ctrl+z按默认处理
+void init_subshell()
+{
+    while (job_head != NULL)
+    {
+        del_job(job_head);
+    }
+    interactive = 0;
+    job_control = 0;
+
+    init_signals();
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTSTP, SIG_DFL);
+}
+
+// 在PATH中查找指令，找到返回0
+// 先查PATH缓存，未命中时再逐个目录查找并记录结果
+int find_cmd(char *name, char *path, size_t size)
+{
+    struct stat st;
+
+    // 含'/'的指令直接使用
+    if (strchr(name, '/') != NULL)
+    {
+        snprintf(path, size, "%s", name);
+        return access(path, X_OK);
+    }
+
+    // PATH变化或目录被修改时更新缓存
+    path_hash_check();
+
+    // 查缓存
+    for (path_entry *e = path_hash[hash_str(name) % PATH_HASH_SIZE]; e; e = e->next)
+    {
+        if (strcmp(e->name, name) == 0)
+        {
+            e->hits++;
+            snprintf(path, size, "%s", e->path);
+            return 0;
+        }
+    }
+
+    // 逐个目录查找
+    for (int i = 0; i < path_dir_num; i++)
+    {
+        // 空目录表示当前目录
+        if (strlen(path_dirs[i]) == 0)
+        {
+            snprintf(path, size, "%s", name);
+        }
+        else
+        {
+            snprintf(path, size, "%s/%s", path_dirs[i], name);
+        }
+
+        if (stat(path, &st) == 0 && S_ISREG(st.st_mode) && access(path, X_OK) == 0)
+        {
+            path_hash_add(name, path, i);
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+// 字符串哈希(FNV-1a)
+unsigned int hash_str(const char *str)
+{
+    unsigned int h = 2166136261u;
+    while (*str)
+    {
+        h ^= (unsigned char)*str++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// 按当前PATH重建目录列表并记录各目录mtime
+void path_hash_load()
+{
+    char *env_path = get_var("PATH");
+    if (env_path == NULL)
+    {
+        env_path = "/usr/local/bin:/usr/bin:/bin";
+    }
+
+    for (int i = 0; i < path_dir_num; i++)
+    {
+        free(path_dirs[i]);
+    }
+    free(path_dirs);
+    free(path_mtime);
+    free(path_value);
+
+    path_value = strdup(env_path);
+
+    // 统计目录数
+    path_dir_num = 1;
+    for (char *c = env_path; *c; c++)
+    {
+        if (*c == ':')
+        {
+            path_dir_num++;
+        }
+    }
+    path_dirs = (char **)malloc(sizeof(char *) * path_dir_num);
+    path_mtime = (struct timespec *)malloc(sizeof(struct timespec) * path_dir_num);
+
+    // 分割目录
+    char *dir = env_path;
+    for (int i = 0; i < path_dir_num; i++)
+    {
+        char *end = strchr(dir, ':');
+        int len = end ? (int)(end - dir) : (int)strlen(dir);
+        path_dirs[i] = strndup(dir, len);
+
+        struct stat st;
+        if (stat(len ? path_dirs[i] : ".", &st) == 0)
+        {
+            path_mtime[i] = st.st_mtim;
+        }
+        else
+        {
+            path_mtime[i].tv_sec = 0;
+            path_mtime[i].tv_nsec = 0;
+        }
+        dir = end ? end + 1 : dir + len;
+    }
+
+    path_checked = time(NULL);
+}
+
+// 检查PATH及其目录是否变化
+void path_hash_check()
+{
+    char *env_path = get_var("PATH");
+
+    // PATH被外部修改
+    if (path_value == NULL || (env_path && strcmp(env_path, path_value)))
+    {
+        path_hash_clear();
+        path_hash_load();
+        return;
+    }
+
+    // 限制stat频率
+    time_t now = time(NULL);
+    if (now - path_checked < PATH_CHECK_INTERVAL)
+    {
+        return;
+    }
+    path_checked = now;
+
+    // 找到第一个mtime变化的目录
+    int changed = -1;
+    for (int i = 0; i < path_dir_num; i++)
+    {
+        struct stat st;
+        struct timespec mtime = {0, 0};
+        if (stat(strlen(path_dirs[i]) ? path_dirs[i] : ".", &st) == 0)
+        {
+            mtime = st.st_mtim;
+        }
+        if (mtime.tv_sec != path_mtime[i].tv_sec || mtime.tv_nsec != path_mtime[i].tv_nsec)
+        {
+            path_mtime[i] = mtime;
+            if (changed < 0)
+            {
+                changed = i;
+            }
+        }
+    }
+    if (changed < 0)
+    {
+        return;
+    }
+
+    // 该目录中的指令可能被删除，之后目录中的指令可能被新文件遮蔽
+    for (int i = 0; i < PATH_HASH_SIZE; i++)
+    {
+        path_entry **pp = &path_hash[i];
+        while (*pp)
+        {
+            path_entry *e = *pp;
+            if (e->dir_idx >= changed)
+            {
+                *pp = e->next;
+                free(e->name);
+                free(e->path);
+                free(e);
+            }
+            else
+            {
+                pp = &e->next;
+            }
+        }
+    }
+}
+
+// 清空PATH缓存
+void path_hash_clear()
+{
+    for (int i = 0; i < PATH_HASH_SIZE; i++)
+    {
+        path_entry *e = path_hash[i];
+        while (e)
+        {
+            path_entry *next = e->next;
+            free(e->name);
+            free(e->path);
+            free(e);
+            e = next;
+        }
+        path_hash[i] = NULL;
+    }
+
+    // 下次查找时重建目录列表
+    free(path_value);
+    path_value = NULL;
+}
+
+// 新增或更新PATH缓存项
+void path_hash_add(char *name, char *path, int dir_idx)
+{
+    path_hash_del(name);
+
+    path_entry *e = (path_entry *)malloc(sizeof(path_entry));
+    e->name = strdup(name);
+    e->path = strdup(path);
+    e->dir_idx = dir_idx;
+    e->hits = 0;
+
+    unsigned int h = hash_str(name) % PATH_HASH_SIZE;
+    e->next = path_hash[h];
+    path_hash[h] = e;
+}
+
+// 删除PATH缓存项，不存在时返回-1
+int path_hash_del(char *name)
+{
+    path_entry **pp = &path_hash[hash_str(name) % PATH_HASH_SIZE];
+    while (*pp)
+    {
+        path_entry *e = *pp;
+        if (strcmp(e->name, name) == 0)
+        {
+            *pp = e->next;
+            free(e->name);
+            free(e->path);
+            free(e);
+            return 0;
+        }
+        pp = &e->next;
+    }
+    return -1;
+}
+
+// 重定向处理，按顺序应用，每个fd只dup2一次
+int handle_redirect(redirect *r)
+{
+    for (; r != NULL; r = r->next)
+    {
+        char *target = expand_word(r->target, r->type == TOK_DLESS ? EXP_NOVARS : 0);
+        if (target == NULL)
+        {
+            return 1;
+        }
+
+        // 复制或关闭已有的fd
+        if (r->type == TOK_LESSAND || r->type == TOK_GREATAND)
+        {
+            if (strcmp(target, "-") == 0)
+            {
+                close(r->fd);
+                continue;
+            }
+            int fd = dup_target(target);
+            if (fd < 0)
+            {
+                return 1;
+            }
+            if (fd != r->fd && dup2(fd, r->fd) < 0)
+            {
+                printf("myshell: %s: %s\n", target, strerror(errno));
+                return 1;
+            }
+            continue;
+        }
+
+        int fd = open_redirect(r, target);
+        if (fd < 0)
+        {
+            return 1;
+        }
+        if (fd != r->fd)
+        {
+            dup2(fd, r->fd);
+            close(fd);
+        }
+    }
+
+    return 0;
+}
+
+// posix_spawn的重定向处理，文件在shell中打开以便报告错误，子进程中只做dup2
+// 打开的fd记录在fds中，以-1结尾，启动后由调用者关闭
+int spawn_redirect(redirect *r, posix_spawn_file_actions_t *actions, int *fds)
+{
+    redirect *head = r;
+    int n = 0;
+    fds[0] = -1;
+    for (; r != NULL; r = r->next)
+    {
+        char *target = expand_word(r->target, r->type == TOK_DLESS ? EXP_NOVARS : 0);
+        if (target == NULL)
+        {
+            return 1;
+        }
+
+        // 复制或关闭已有的fd
+        if (r->type == TOK_LESSAND || r->type == TOK_GREATAND)
+        {
+            if (strcmp(target, "-") == 0)
+            {
+                posix_spawn_file_actions_addclose(actions, r->fd);
+                continue;
+            }
+            int fd = dup_target(target);
+            if (fd < 0)
+            {
+                return 1;
+            }
+            // 不是由之前的重定向打开的fd须已在shell中打开
+            redirect *p = head;
+            while (p != r && p->fd != fd)
+            {
+                p = p->next;
+            }
+            if (p == r && fcntl(fd, F_GETFD) < 0)
+            {
+                printf("myshell: %s: %s\n", target, strerror(errno));
+                return 1;
+            }
+            posix_spawn_file_actions_adddup2(actions, fd, r->fd);
+            continue;
+        }
+
+        // 打开的fd均为close-on-exec，子进程中无需关闭
+        int fd = open_redirect(r, target);
+        if (fd < 0)
+        {
+            return 1;
+        }
+        fds[n++] = fd;
+        fds[n] = -1;
+        posix_spawn_file_actions_adddup2(actions, fd, r->fd);
+    }
+
+    return 0;
+}
+
+// 重定向是否在读取fd之前覆盖了它，此时管道无需再dup2到该fd
+int redirect_covers(redirect *r, int fd)
+{
+    for (; r != NULL; r = r->next)
+    {
+        // n>&fd引用了原来的fd，展开后才能确定的也视为引用
+        if ((r->type == TOK_LESSAND || r->type == TOK_GREATAND) && strcmp(r->target, "-") != 0
+            && (strspn(r->target, "0123456789") != strlen(r->target) || atoi(r->target) == fd))
+        {
+            return 0;
+        }
+        if (r->fd == fd)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// 打开重定向的文件或here-doc，返回close-on-exec且不小于REDIR_FD_MIN的fd，失败返回-1
+int open_redirect(redirect *r, char *target)
+{
+    int fd;
+    int mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+
+    switch (r->type)
+    {
+    // 输入重定向
+    case TOK_LESS:
+        fd = open(target, O_RDONLY | O_CLOEXEC);
+        break;
+    // 输出重定向
+    case TOK_GREAT:
+        fd = open(target, O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, mode);
+        break;
+    // 追加输出
+    case TOK_DGREAT:
+        fd = open(target, O_CREAT | O_APPEND | O_WRONLY | O_CLOEXEC, mode);
+        break;
+    // 读写打开
+    case TOK_LESSGREAT:
+        fd = open(target, O_CREAT | O_RDWR | O_CLOEXEC, mode);
+        break;
+    // here-doc，结束标记不含引号时展开正文中的变量
+    case TOK_DLESS:
+    {
+        char *body = doc_bodies[r->doc];
+        if (strpbrk(r->target, "'\"\\") == NULL && (body = expand_word(body, EXP_HEREDOC)) == NULL)
+        {
+            return -1;
+        }
+        return doc_fd(body, strlen(body));
+    }
+    // here-string，末尾补换行
+    default:
+    {
+        size_t len = strlen(target);
+        char *body = arena_alloc(&line_arena, len + 2);
+        memcpy(body, target, len);
+        body[len] = '\n';
+        body[len + 1] = '\0';
+        return doc_fd(body, len + 1);
+    }
+    }
+
+    if (fd < 0)
+    {
+        printf("myshell: %s: %s\n", target, strerror(errno));
+        return -1;
+    }
+    return move_fd_high(fd);
+}
+
+// 解析n>&m中的m，不是fd编号时返回-1
+int dup_target(char *target)
+{
+    char *end;
+    long fd = strtol(target, &end, 10);
+    if (*target < '0' || *target > '9' || *end != '\0' || fd > INT_MAX)
+    {
+        printf("myshell: %s: ambiguous redirect\n", target);
+        return -1;
+    }
+    return (int)fd;
+}
+
+// 以管道提供here-doc正文，不使用临时文件
+// 正文能放入管道时直接写入，否则fork子进程写出剩余部分，返回管道读端，失败返回-1
+int doc_fd(const char *body, size_t len)
+{
+    int p[2];
+    if (pipe(p))
+    {
+        printf("pipe error\n");
+        return -1;
+    }
+
+    fcntl(p[1], F_SETFL, O_NONBLOCK);
+    size_t done = 0;
+    while (done < len)
+    {
+        ssize_t got = write(p[1], body + done, len - done);
+        if (got < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (got <= 0)
+        {
+            break;
+        }
+        done += got;
+    }
+
+    if (done < len)
+    {
+        // 写入进程留在shell的进程组，读端关闭时被SIGPIPE终止
+        pid_t pid;
+        fflush(stdout);
+        if ((pid = fork()) < 0)
+        {
+            printf("fork error\n");
+        }
+        else if (pid == 0)
+        {
+            init_child(-1, 0);
+            close(p[0]);
+            fcntl(p[1], F_SETFL, 0);
+            while (done < len)
+            {
+                ssize_t got = write(p[1], body + done, len - done);
+                if (got < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (got <= 0)
+                {
+                    break;
+                }
+                done += got;
+            }
+            _exit(0);
+        }
+    }
+    close(p[1]);
+
+    fcntl(p[0], F_SETFD, FD_CLOEXEC);
+    return move_fd_high(p[0]);
+}
+
+// 将fd移到REDIR_FD_MIN以上并设置close-on-exec
+int move_fd_high(int fd)
+{
+    if (fd >= REDIR_FD_MIN)
+    {
+        return fd;
+    }
+    int high = fcntl(fd, F_DUPFD_CLOEXEC, REDIR_FD_MIN);
+    close(fd);
+    if (high < 0)
+    {
+        printf("myshell: %s\n", strerror(errno));
+    }
+    return high;
+}
+
+// 展开AST中的单词，结果按IFS分割并匹配文件名，AST本身保持不变，失败返回NULL
+char **expand_words(command *c)
+{
+    // ((中的表达式不分割也不匹配文件名
+    fieldlist f = {0};
+    f.split = c->argc == 0 || strcmp(c->words[0], "((") != 0;
+    for (int i = 0; i < c->argc; i++)
+    {
+        // 不含引号、变量及通配符的单词原样使用，循环中的指令多为这种单词
+        if (c->words[i][strcspn(c->words[i], "'\"\\$~*?[")] == '\0')
+        {
+            field_push(&f, c->words[i], strlen(c->words[i]));
+            continue;
+        }
+        if (expand_into(&f, c->words[i], 0))
+        {
+            free(f.cur.s);
+            free(f.pat.s);
+            return NULL;
+        }
+        field_end(&f);
+    }
+    free(f.cur.s);
+    free(f.pat.s);
+
+    char **args = (char **)arena_alloc(&line_arena, sizeof(char *) * (f.num + 1));
+    if (f.num > 0)
+    {
+        memcpy(args, f.v, sizeof(char *) * f.num);
+    }
+    args[f.num] = NULL;
+    return args;
+}
+
+// 展开单个单词，不做字段分割，多个字段以空格连接，失败返回NULL
+char *expand_word(const char *word, int mode)
+{
+    fieldlist f = {0};
+    int err = expand_into(&f, word, mode);
+    field_end(&f);
+    free(f.cur.s);
+    if (err)
+    {
+        return NULL;
+    }
+
+    strbuf sb = {NULL, 0, 0};
+    sb_append(&sb, "", 0);
+    for (int i = 0; i < f.num; i++)
+    {
+        if (i > 0)
+        {
+            sb_append(&sb, " ", 1);
+        }
+        sb_append(&sb, f.v[i], strlen(f.v[i]));
+    }
+    char *result = arena_strndup(&line_arena, sb.s, sb.len);
+    free(sb.s);
+    return result;
+}
+
+// 展开单词中的~、变量及引号，结果追加到f的当前字段，失败返回1
+int expand_into(fieldlist *f, const char *word, int mode)
+{
+    int heredoc = mode & EXP_HEREDOC;
+    int dq = 0;
+    const char *p = word;
+
+    // 开头的~为$HOME
+    if (!heredoc && !(mode & EXP_NOVARS) && *p == '~' && (p[1] == '\0' || p[1] == '/'))
+    {
+        char *home = get_var("HOME");
+        if (home != NULL)
+        {
+            field_add(f, home, strlen(home), FIELD_QUOTED);
+            p++;
+        }
+    }
+
+    while (*p)
+    {
+        // 单引号内全部按字面处理
+        if (*p == '\'' && !dq && !heredoc)
+        {
+            const char *end = strchr(p + 1, '\'');
+            if (end == NULL)
+            {
+                end = p + strlen(p);
+            }
+            field_add(f, p + 1, end - p - 1, FIELD_QUOTED);
+            f->open = 1;
+            p = *end ? end + 1 : end;
+        }
+        // 双引号内只展开变量，不分割
+        else if (*p == '"' && !heredoc)
+        {
+            dq = !dq;
+            if (dq)
+            {
+                f->open = 1;
+            }
+            p++;
+        }
+        // 转义，双引号及here-doc中除$ ` " \外保留反斜杠
+        else if (*p == '\\' && p[1] != '\0')
+        {
+            if ((dq || heredoc) && !strchr(heredoc ? "$`\\" : "$`\"\\", p[1]))
+            {
+                field_add(f, p, 2, FIELD_QUOTED);
+            }
+            else
+            {
+                field_add(f, p + 1, 1, FIELD_QUOTED);
+            }
+            p += 2;
+        }
+        else if (*p == '$' && !(mode & EXP_NOVARS))
+        {
+            int n = expand_param(f, p, dq || heredoc);
+            if (n < 0)
+            {
+                return 1;
+            }
+            p += n;
+        }
+        else
+        {
+            field_add(f, p, 1, (dq || heredoc) ? FIELD_QUOTED : FIELD_LITERAL);
+            p++;
+        }
+    }
+
+    return 0;
+}
+
+// 展开p处的$name、${...}，返回消耗的字符数，失败返回-1
+int expand_param(fieldlist *f, const char *p, int quoted)
+{
+    const char *name = p + 1;
+    size_t len = 0;
+    const char *op = NULL;
+    const char *word = NULL;
+    size_t word_len = 0;
+    int length = 0;
+    int used;
+
+    // 算术展开$((expr))，表达式中先展开变量
+    if (name[0] == '(' && name[1] == '(')
+    {
+        const char *end = match_paren(name);
+        if (end == NULL || end[-1] != ')')
+        {
+            printf("myshell: %s: bad substitution\n", p);
+            return -1;
+        }
+        long long value;
+        if (arith_word(arena_strndup(&line_arena, name + 2, end - name - 3), &value))
+        {
+            return -1;
+        }
+        char buf[24];
+        int n = snprintf(buf, sizeof(buf), "%lld", value);
+        field_add(f, buf, n, quoted ? FIELD_QUOTED : FIELD_EXPANDED);
+        return end - p + 1;
+    }
+
+    if (*name == '{')
+    {
+        // 找到匹配的}
+        const char *end = name + 1;
+        int depth = 1;
+        for (; *end; end++)
+        {
+            if (*end == '{')
+            {
+                depth++;
+            }
+            else if (*end == '}' && --depth == 0)
+            {
+                break;
+            }
+        }
+        if (*end == '\0')
+        {
+            printf("myshell: %s: bad substitution\n", p);
+            return -1;
+        }
+        used = end - p + 1;
+
+        name++;
+        // ${#var}为长度，${#}仍为参数个数
+        if (*name == '#' && name + 1 < end)
+        {
+            length = 1;
+            name++;
+        }
+        if (strchr("?#@*$", *name) && *name)
+        {
+            len = 1;
+        }
+        else
+        {
+            while (name + len < end && (isalnum((unsigned char)name[len]) || name[len] == '_'))
+            {
+                len++;
+            }
+        }
+
+        // 默认值等操作
+        op = name + len;
+        if (op < end)
+        {
+            int op_len = (*op == ':') ? 2 : 1;
+            if (length || len == 0 || op + op_len > end || !strchr("-=+?", op[op_len - 1]))
+            {
+                printf("myshell: %.*s: bad substitution\n", used, p);
+                return -1;
+            }
+            word = op + op_len;
+            word_len = end - word;
+        }
+        else
+        {
+            op = NULL;
+        }
+        if (len == 0)
+        {
+            printf("myshell: %.*s: bad substitution\n", used, p);
+            return -1;
+        }
+    }
+    // 特殊参数及$0-$9
+    else if (*name && (strchr("?#@*$", *name) || isdigit((unsigned char)*name)))
+    {
+        len = 1;
+        used = 2;
+    }
+    else if (isalpha((unsigned char)*name) || *name == '_')
+    {
+        while (isalnum((unsigned char)name[len]) || name[len] == '_')
+        {
+            len++;
+        }
+        used = len + 1;
+    }
+    // 不是变量，按字面处理
+    else
+    {
+        field_add(f, p, 1, quoted ? FIELD_QUOTED : FIELD_LITERAL);
+        return 1;
+    }
+
+    // "$@"每个位置参数为一个字段
+    if (quoted && !length && op == NULL && *name == '@')
+    {
+        if (pos_num == 0 && f->cur.len == 0)
+        {
+            f->open = 0;
+        }
+        for (int i = 0; i < pos_num; i++)
+        {
+            if (i > 0)
+            {
+                field_end(f);
+            }
+            field_add(f, pos_args[i], strlen(pos_args[i]), FIELD_QUOTED);
+        }
+        return used;
+    }
+
+    const char *value = get_param(name, len);
+    if (length)
+    {
+        char *num = (char *)arena_alloc(&line_arena, 24);
+        snprintf(num, 24, "%zu", value ? strlen(value) : 0);
+        value = num;
+    }
+    else if (op != NULL)
+    {
+        // 带:时空值视为未设置
+        int unset = value == NULL || (*op == ':' && *value == '\0');
+        char type = op[*op == ':' ? 1 : 0];
+        char *arg = NULL;
+        if ((type == '+') != unset)
+        {
+            arg = expand_word(arena_strndup(&line_arena, word, word_len), 0);
+            if (arg == NULL)
+            {
+                return -1;
+            }
+        }
+
+        if (type == '-' && unset)
+        {
+            value = arg;
+        }
+        else if (type == '+')
+        {
+            value = unset ? "" : arg;
+        }
+        else if (type == '=' && unset)
+        {
+            if (!valid_name(name, len))
+            {
+                printf("myshell: $%.*s: cannot assign in this way\n", (int)len, name);
+                return -1;
+            }
+            set_var(arena_strndup(&line_arena, name, len), arg);
+            value = arg;
+        }
+        else if (type == '?' && unset)
+        {
+            printf("myshell: %.*s: %s\n", (int)len, name, *arg ? arg : "parameter null or not set");
+            return -1;
+        }
+    }
+
+    if (value != NULL)
+    {
+        field_add(f, value, strlen(value), quoted ? FIELD_QUOTED : FIELD_EXPANDED);
+    }
+    return used;
+}
+
+// 取得参数的值，未设置返回NULL
+const char *get_param(const char *name, size_t len)
+{
+    char *value;
+
+    // 上一个管道的退出码
+    if (len == 1 && *name == '?')
+    {
+        value = (char *)arena_alloc(&line_arena, 16);
+        snprintf(value, 16, "%d", last_status);
+        return value;
+    }
+    // 位置参数个数
+    if (len == 1 && *name == '#')
+    {
+        value = (char *)arena_alloc(&line_arena, 16);
+        snprintf(value, 16, "%d", pos_num);
+        return value;
+    }
+    // shell的pid
+    if (len == 1 && *name == '$')
+    {
+        value = (char *)arena_alloc(&line_arena, 16);
+        snprintf(value, 16, "%d", (int)getpid());
+        return value;
+    }
+    // 全部位置参数，以空格连接
+    if (len == 1 && (*name == '@' || *name == '*'))
+    {
+        strbuf sb = {NULL, 0, 0};
+        sb_append(&sb, "", 0);
+        for (int i = 0; i < pos_num; i++)
+        {
+            if (i > 0)
+            {
+                sb_append(&sb, " ", 1);
+            }
+            sb_append(&sb, pos_args[i], strlen(pos_args[i]));
+        }
+        value = arena_strndup(&line_arena, sb.s, sb.len);
+        free(sb.s);
+        return value;
+    }
+    // $0及位置参数
+    if (isdigit((unsigned char)*name))
+    {
+        int n = atoi(name);
+        if (n == 0)
+        {
+            return shell_name;
+        }
+        return n <= pos_num ? pos_args[n - 1] : NULL;
+    }
+    // 上一个管道各阶段的退出码，以空格分隔
+    if (len == 10 && strncmp(name, "PIPESTATUS", 10) == 0)
+    {
+        value = (char *)arena_alloc(&line_arena, 12 * pipe_status_num + 1);
+        size_t n = 0;
+        value[0] = '\0';
+        for (int i = 0; i < pipe_status_num; i++)
+        {
+            n += sprintf(value + n, i ? " %d" : "%d", pipe_status[i]);
+        }
+        return value;
+    }
+
+    return get_var(arena_strndup(&line_arena, name, len));
+}
+
+// 向当前字段追加内容，from为FIELD_EXPANDED且需要分割时遇到IFS中的字符结束字段
+void field_add(fieldlist *f, const char *str, size_t len, int from)
+{
+    const char *ifs = NULL;
+    if (from == FIELD_EXPANDED && f->split)
+    {
+        ifs = get_var("IFS");
+        if (ifs == NULL)
+        {
+            ifs = " \t\n";
+        }
+    }
+
+    for (size_t i = 0; i < len; i++)
+    {
+        if (ifs != NULL && str[i] && strchr(ifs, str[i]))
+        {
+            field_end(f);
+            continue;
+        }
+        sb_append(&f->cur, str + i, 1);
+        f->open = 1;
+
+        // 分割时才匹配文件名
+        if (f->split || f->pattern)
+        {
+            if (from == FIELD_QUOTED && strchr("*?[]\\", str[i]))
+            {
+                sb_append(&f->pat, "\\", 1);
+            }
+            else if (from != FIELD_QUOTED && strchr("*?[", str[i]))
+            {
+                f->glob = 1;
+            }
+            sb_append(&f->pat, str + i, 1);
+        }
+    }
+}
+
+// 结束当前字段，含通配符时替换为匹配的文件名，没有匹配时保留原文，字段不存在时忽略
+void field_end(fieldlist *f)
+{
+    if (!f->open)
+    {
+        return;
+    }
+    int num = f->num;
+    if (f->glob && f->split)
+    {
+        glob_expand(f);
+    }
+    if (f->num == num)
+    {
+        field_push(f, f->cur.s ? f->cur.s : "", f->cur.len);
+    }
+    f->cur.len = 0;
+    f->pat.len = 0;
+    f->open = 0;
+    f->glob = 0;
+}
+
+// 增加一个字段
+void field_push(fieldlist *f, const char *str, size_t len)
+{
+    if (f->num == f->cap)
+    {
+        f->cap = f->cap ? f->cap * 2 : 8;
+        char **v = (char **)arena_alloc(&line_arena, sizeof(char *) * f->cap);
+        if (f->num > 0)
+        {
+            memcpy(v, f->v, sizeof(char *) * f->num);
+        }
+        f->v = v;
+    }
+    f->v[f->num++] = arena_strndup(&line_arena, str, len);
+}
+
+// 以当前字段的模式匹配文件名，匹配结果排序后加入字段
+void glob_expand(fieldlist *f)
+{
+    // 按/分割模式，忽略空的段
+    char *pat = arena_strndup(&line_arena, f->pat.s, f->pat.len);
+    char **segs = (char **)arena_alloc(&line_arena, sizeof(char *) * (f->pat.len / 2 + 2));
+    int num = 0;
+    for (char *s = strtok(pat, "/"); s != NULL; s = strtok(NULL, "/"))
+    {
+        segs[num++] = s;
+    }
+    int glob = 0;
+    for (int i = 0; i < num && !glob; i++)
+    {
+        glob = has_glob(segs[i]);
+    }
+    if (!glob)
+    {
+        return;
+    }
+
+    int start = f->num;
+    glob_walk(f, f->pat.s[0] == '/' ? "/" : "", segs, 0, num);
+
+    // 以/结尾的模式只匹配目录
+    if (f->pat.s[f->pat.len - 1] == '/')
+    {
+        int n = start;
+        for (int i = start; i < f->num; i++)
+        {
+            struct stat st;
+            if (stat(f->v[i], &st) == 0 && S_ISDIR(st.st_mode))
+            {
+                f->v[n++] = join_path(f->v[i], "");
+            }
+        }
+        f->num = n;
+    }
+    qsort(f->v + start, f->num - start, sizeof(char *), cmp_str);
+}
+
+// 从目录base开始匹配第idx段及之后的模式，base为空表示当前目录
+// 不含通配符的段直接拼接，不读取目录
+void glob_walk(fieldlist *f, const char *base, char **segs, int idx, int num)
+{
+    char *seg = segs[idx];
+    int last = idx == num - 1;
+
+    // 普通的段，去掉转义后拼接
+    if (!has_glob(seg))
+    {
+        char *name = arena_alloc(&line_arena, strlen(seg) + 1);
+        char *d = name;
+        for (char *c = seg; *c; c++)
+        {
+            if (*c == '\\' && c[1])
+            {
+                c++;
+            }
+            *d++ = *c;
+        }
+        *d = '\0';
+
+        char *path = join_path(base, name);
+        struct stat st;
+        if (!last)
+        {
+            glob_walk(f, path, segs, idx + 1, num);
+        }
+        else if (lstat(path, &st) == 0)
+        {
+            field_push(f, path, strlen(path));
+        }
+        return;
+    }
+
+    glob_dir *dir = glob_get_dir(base);
+    if (dir == NULL)
+    {
+        return;
+    }
+
+    // **匹配零或多层目录
+    int any = strcmp(seg, "**") == 0;
+    if (any && !last)
+    {
+        glob_walk(f, base, segs, idx + 1, num);
+    }
+
+    for (int i = 0; i < dir->num; i++)
+    {
+        dir_entry *e = &dir->ents[i];
+        // 以.开头的文件只能由以.开头的模式匹配
+        if (e->name[0] == '.' && seg[0] != '.')
+        {
+            continue;
+        }
+        if (!any && !glob_match(seg, seg + strlen(seg), e->name))
+        {
+            continue;
+        }
+
+        char *path = join_path(base, e->name);
+        if (last)
+        {
+            field_push(f, path, strlen(path));
+        }
+
+        // 子目录，符号链接及类型未知时需要stat
+        int is_dir = e->type == DT_DIR;
+        if ((!last || any) && (e->type == DT_LNK || e->type == DT_UNKNOWN))
+        {
+            struct stat st;
+            is_dir = stat(path, &st) == 0 && S_ISDIR(st.st_mode) && !(any && e->type == DT_LNK);
+        }
+        if (is_dir && (any || !last))
+        {
+            glob_walk(f, path, segs, any ? idx : idx + 1, num);
+        }
+    }
+}
+
+// 匹配单个文件名，支持* ? [...]及反斜杠转义
+int glob_match(const char *p, const char *pe, const char *name)
+{
+    // 最近的*及其匹配开始的位置，失败时回溯
+    const char *star_p = NULL;
+    const char *star_n = NULL;
+
+    while (*name)
+    {
+        if (p < pe && *p == '*')
+        {
+            star_p = ++p;
+            star_n = name;
+            continue;
+        }
+        if (p < pe)
+        {
+            int ok;
+            const char *next = glob_char(p, pe, *name, &ok);
+            if (ok)
+            {
+                p = next;
+                name++;
+                continue;
+            }
+        }
+        if (star_p == NULL)
+        {
+            return 0;
+        }
+        p = star_p;
+        name = ++star_n;
+    }
+
+    while (p < pe && *p == '*')
+    {
+        p++;
+    }
+    return p == pe;
+}
+
+// 以模式中p处的单个元素匹配字符c，ok为是否匹配，返回下一个元素
+const char *glob_char(const char *p, const char *pe, char c, int *ok)
+{
+    if (*p == '?')
+    {
+        *ok = 1;
+        return p + 1;
+    }
+    if (*p == '\\' && p + 1 < pe)
+    {
+        *ok = p[1] == c;
+        return p + 2;
+    }
+    if (*p != '[')
+    {
+        *ok = *p == c;
+        return p + 1;
+    }
+
+    // 字符集，以!或^取反，开头的]为普通字符，没有结束的]时[为普通字符
+    const char *q = p + 1;
+    int negate = q < pe && (*q == '!' || *q == '^');
+    if (negate)
+    {
+        q++;
+    }
+    int match = 0;
+    const char *first = q;
+    while (q < pe && (*q != ']' || q == first))
+    {
+        char lo = *q;
+        if (lo == '\\' && q + 1 < pe)
+        {
+            lo = *++q;
+        }
+        char hi = lo;
+        if (q + 2 < pe && q[1] == '-' && q[2] != ']')
+        {
+            q += 2;
+            hi = *q;
+            if (hi == '\\' && q + 1 < pe)
+            {
+                hi = *++q;
+            }
+        }
+        if ((unsigned char)c >= (unsigned char)lo && (unsigned char)c <= (unsigned char)hi)
+        {
+            match = 1;
+        }
+        q++;
+    }
+    if (q >= pe)
+    {
+        *ok = c == '[';
+        return p + 1;
+    }
+    *ok = match != negate;
+    return q + 1;
+}
+
+// 检查模式的段是否含未转义的通配符
+int has_glob(const char *seg)
+{
+    for (; *seg; seg++)
+    {
+        if (*seg == '\\' && seg[1])
+        {
+            seg++;
+        }
+        else if (*seg == '*' || *seg == '?' || (*seg == '[' && strchr(seg + 1, ']')))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 取得目录的文件列表，同一行中只读取一次，目录改变后重新读取，失败返回NULL
+glob_dir *glob_get_dir(const char *path)
+{
+    const char *dir_path = *path ? path : ".";
+    struct stat st;
+    if (stat(dir_path, &st) || !S_ISDIR(st.st_mode))
+    {
+        return NULL;
+    }
+
+    unsigned int h = hash_str(dir_path) % GLOB_HASH_SIZE;
+    glob_dir *d;
+    for (d = glob_hash[h]; d; d = d->next)
+    {
+        if (strcmp(d->path, dir_path) == 0)
+        {
+            if (d->ino == st.st_ino && d->mtime.tv_sec == st.st_mtim.tv_sec && d->mtime.tv_nsec == st.st_mtim.tv_nsec)
+            {
+                return d;
+            }
+            break;
+        }
+    }
+
+    int fd = open(dir_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    dir_entry *ents = NULL;
+    int num = read_dir(fd, &line_arena, &ents);
+    close(fd);
+    if (num < 0)
+    {
+        free(ents);
+        return NULL;
+    }
+    if (num > 0)
+    {
+        qsort(ents, num, sizeof(dir_entry), cmp_dir_entry);
+    }
+
+    if (d == NULL)
+    {
+        d = (glob_dir *)arena_alloc(&line_arena, sizeof(glob_dir));
+        d->path = arena_strndup(&line_arena, dir_path, strlen(dir_path));
+        d->next = glob_hash[h];
+        glob_hash[h] = d;
+    }
+    else
+    {
+        free(d->ents);
+    }
+    d->ino = st.st_ino;
+    d->mtime = st.st_mtim;
+    d->ents = ents;
+    d->num = num;
+
+    return d;
+}
+
+// 清空目录缓存，缓存项在line_arena中，重置之前调用
+void glob_cache_clear()
+{
+    for (int i = 0; i < GLOB_HASH_SIZE; i++)
+    {
+        for (glob_dir *d = glob_hash[i]; d; d = d->next)
+        {
+            free(d->ents);
+        }
+        glob_hash[i] = NULL;
+    }
+}
+
+// 拼接路径，base为空时返回name
+char *join_path(const char *base, const char *name)
+{
+    size_t blen = strlen(base);
+    size_t nlen = strlen(name);
+    char *path = (char *)arena_alloc(&line_arena, blen + nlen + 2);
+    memcpy(path, base, blen);
+    if (blen > 0 && base[blen - 1] != '/')
+    {
+        path[blen++] = '/';
+    }
+    memcpy(path + blen, name, nlen + 1);
+    return path;
+}
+
+// 检查变量名是否合法
+int valid_name(const char *name, size_t len)
+{
+    if (len == 0 || isdigit((unsigned char)name[0]))
+    {
+        return 0;
+    }
+    for (size_t i = 0; i < len; i++)
+    {
+        if (!isalnum((unsigned char)name[i]) && name[i] != '_')
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// 查找shell变量，不存在返回NULL
+var *find_var(const char *name)
+{
+    for (var *v = var_hash[hash_str(name) % VAR_HASH_SIZE]; v; v = v->next)
+    {
+        if (strcmp(v->name, name) == 0)
+        {
+            return v;
+        }
+    }
+    return NULL;
+}
+
+// 取得变量的值，未设置返回NULL
+char *get_var(const char *name)
+{
+    var *v = find_var(name);
+    return v ? v->value : NULL;
+}
+
+// 设置变量，新变量不导出，已导出的变量改变时环境需要重建
+void set_var(const char *name, const char *value)
+{
+    var *v = find_var(name);
+    if (v != NULL)
+    {
+        free(v->value);
+        v->value = strdup(value);
+        envp_dirty |= v->exported;
+    }
+    else
+    {
+        unsigned int h = hash_str(name) % VAR_HASH_SIZE;
+        v = (var *)malloc(sizeof(var));
+        v->name = strdup(name);
+        v->value = strdup(value);
+        v->exported = 0;
+        v->next = var_hash[h];
+        var_hash[h] = v;
+    }
+
+    // PATH改变后缓存失效
+    if (strcmp(name, "PATH") == 0)
+    {
+        path_hash_clear();
+    }
+}
+
+// 删除变量
+void unset_var(const char *name)
+{
+    var **pv = &var_hash[hash_str(name) % VAR_HASH_SIZE];
+    for (; *pv; pv = &(*pv)->next)
+    {
+        if (strcmp((*pv)->name, name) == 0)
+        {
+            var *v = *pv;
+            *pv = v->next;
+            envp_dirty |= v->exported;
+            free(v->name);
+            free(v->value);
+            free(v);
+            break;
+        }
+    }
+
+    // PATH改变后缓存失效
+    if (strcmp(name, "PATH") == 0)
+    {
+        path_hash_clear();
+    }
+}
+
+// 导出变量，value为NULL时只设置导出标志，变量不存在则设为空值
+void export_var(const char *name, const char *value)
+{
+    var *v = find_var(name);
+    if (v == NULL || value != NULL)
+    {
+        set_var(name, value ? value : "");
+        v = find_var(name);
+    }
+    envp_dirty |= !v->exported;
+    v->exported = 1;
+}
+
+// 启动时导入环境变量，此后不再修改environ
+void import_environ()
+{
+    for (char **e = environ; *e != NULL; e++)
+    {
+        char *eq = strchr(*e, '=');
+        if (eq == NULL)
+        {
+            continue;
+        }
+        char *name = strndup(*e, eq - *e);
+        export_var(name, eq + 1);
+        free(name);
+    }
+}
+
+// 取得传给子进程的环境，导出的变量未改变时直接复用
+// 指针数组与字符串放在同一块内存中
+char **get_envp()
+{
+    if (!envp_dirty)
+    {
+        return shell_envp;
+    }
+
+    int num = 0;
+    size_t size = 0;
+    for (int i = 0; i < VAR_HASH_SIZE; i++)
+    {
+        for (var *v = var_hash[i]; v; v = v->next)
+        {
+            if (v->exported)
+            {
+                num++;
+                size += strlen(v->name) + strlen(v->value) + 2;
+            }
+        }
+    }
+
+    free(shell_envp);
+    shell_envp = (char **)malloc(sizeof(char *) * (num + 1) + size);
+    char *p = (char *)(shell_envp + num + 1);
+    int n = 0;
+    for (int i = 0; i < VAR_HASH_SIZE; i++)
+    {
+        for (var *v = var_hash[i]; v; v = v->next)
+        {
+            if (v->exported)
+            {
+                shell_envp[n++] = p;
+                p += sprintf(p, "%s=%s", v->name, v->value) + 1;
+            }
+        }
+    }
+    shell_envp[n] = NULL;
+    envp_dirty = 0;
+
+    return shell_envp;
+}
+
+// 按名称排序变量的比较函数
+int cmp_var(const void *a, const void *b)
+{
+    return strcmp((*(var **)a)->name, (*(var **)b)->name);
+}
+
+// 字符串数组排序的比较函数
+int cmp_str(const void *a, const void *b)
+{
+    return strcmp(*(char **)a, *(char **)b);
+}
+
+// 设置位置参数$1...
+void set_pos_args(char **args, int num)
+{
+    for (int i = 0; i < pos_num; i++)
+    {
+        free(pos_args[i]);
+    }
+    free(pos_args);
+
+    pos_args = (char **)malloc(sizeof(char *) * (num + 1));
+    for (int i = 0; i < num; i++)
+    {
+        pos_args[i] = strdup(args[i]);
+    }
+    pos_args[num] = NULL;
+    pos_num = num;
+}
+
+// 查找build in指令，不存在返回NULL
+const buildin *get_cmd(char *cmd)
+{
+    return bsearch(cmd, buildin_list, NUM_OF_CMD, sizeof(buildin), cmp_buildin);
+}
+
+// bsearch比较函数
+int cmp_buildin(const void *key, const void *item)
+{
+    return strcmp((const char *)key, ((const buildin *)item)->name);
+}
+
+// 处理指令，返回退出状态
+int handle_cmd(char **args)
+{
+    const buildin *b = get_cmd(args[0]);
+    if (b == NULL)
+    {
+        error_cmd(args);
+        return 127;
+    }
+
+    return b->func(args);
+}
+
+// bg指令
+int bg(char **args)
+{
+    job *j = find_job(args[0], args[1]);
+    if (j == NULL)
+    {
+        return 1;
+    }
+
+    // 发送信号给整个进程组，管道各阶段一起继续
+    if (kill(-j->pid, SIGCONT) < 0)
+    {
+        printf("bg: send SINCONT error, pid: %d\n", j->pid);
+        return 1;
+    }
+
+    j->status = STAT_CONTINUED;
+    print_job_info(j);
+
+    return 0;
+}
+
+// break指令
+int my_break(char **args)
+{
+    int n = args[1] ? atoi(args[1]) : 1;
+    if (n < 1)
+    {
+        printf("break: %s: loop count out of range\n", args[1]);
+        return 1;
+    }
+    if (loop_depth == 0)
+    {
+        printf("break: only meaningful in a loop\n");
+        return 0;
+    }
+
+    // 超过所在的循环层数时跳出全部循环
+    loop_break = n < loop_depth ? n : loop_depth;
+    return 0;
+}
+
+// cd 指令
+int cd(char **args)
+{
+    if (args[1] == NULL)
+    {
+        return 0;
+    }
+
+    // 按逻辑路径计算新目录，与$PWD保持一致
+    char *path;
+    if (args[1][0] == '/')
+    {
+        path = normalize_path(args[1]);
+    }
+    else
+    {
+        char *pwd = get_pwd();
+        char *joined = (char *)malloc(strlen(pwd) + strlen(args[1]) + 2);
+        sprintf(joined, "%s/%s", pwd, args[1]);
+        path = normalize_path(joined);
+        free(joined);
+    }
+
+    if (chdir(path) == 0)
+    {
+        set_pwd(path);
+        return 0;
+    }
+    free(path);
+
+    // 逻辑路径不可用时按实际路径切换，当前目录需重新获取
+    if (chdir(args[1]) != 0)
+    {
+        printf("Can't find \"%s\" directory\n", args[1]);
+        return 1;
+    }
+    set_pwd(NULL);
+    return 0;
+}
+
+// clr指令
+int clr(char **args)
+{
+    printf("\033[H\033[J");
+    return 0;
+}
+
+// continue指令
+int my_continue(char **args)
+{
+    int n = args[1] ? atoi(args[1]) : 1;
+    if (n < 1)
+    {
+        printf("continue: %s: loop count out of range\n", args[1]);
+        return 1;
+    }
+    if (loop_depth == 0)
+    {
+        printf("continue: only meaningful in a loop\n");
+        return 0;
+    }
+
+    // 跳出n-1层循环后继续第n层的下一轮
+    loop_cont = n < loop_depth ? n : loop_depth;
+    return 0;
+}
+
+// dir指令
+int dir(char **args)
+{
+    int flags = 0;
+    int i = 1;
+
+    // 解析选项
+    for (; args[i] != NULL && args[i][0] == '-' && args[i][1] != '\0'; i++)
+    {
+        for (char *c = args[i] + 1; *c; c++)
+        {
+            if (*c == 'l')
+            {
+                flags |= DIR_LONG;
+            }
+            else if (*c == 'R')
+            {
+                flags |= DIR_RECURSIVE;
+            }
+            else
+            {
+                printf("dir: error argument \"%s\"\n", args[i]);
+                return 1;
+            }
+        }
+    }
+
+    // 输出先写入缓冲区，满DIR_BUF_SIZE才写出
+    strbuf out = {NULL, 0, 0};
+    int result = 0;
+    int num = 0;
+    while (args[i + num] != NULL)
+    {
+        num++;
+    }
+    if (num == 0)
+    {
+        result = list_dir(".", flags, &out);
+    }
+    for (int k = 0; k < num; k++)
+    {
+        // 多个目录或递归时先打印目录名
+        if (num > 1 || (flags & DIR_RECURSIVE))
+        {
+            if (k > 0)
+            {
+                sb_append(&out, "\n", 1);
+            }
+            sb_append(&out, args[i + k], strlen(args[i + k]));
+            sb_append(&out, ":\n", 2);
+        }
+        result |= list_dir(args[i + k], flags, &out);
+    }
+
+    dir_flush(&out, 0);
+    free(out.s);
+
+    return result;
+}
+
+// 列出单个目录，以getdents64批量读取目录项，排序后写入out，失败返回1
+int list_dir(const char *path, int flags, strbuf *out)
+{
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        dir_flush(out, 0);
+        printf("Can't find \"%s\" directory\n", path);
+        return 1;
+    }
+
+    // 文件名放在内存池中，目录列出后整体释放
+    arena names = {NULL};
+    dir_entry *ents = NULL;
+    int result = 0;
+    int num = read_dir(fd, &names, &ents);
+    if (num < 0)
+    {
+        dir_flush(out, 0);
+        printf("dir: %s: %s\n", path, strerror(errno));
+        result = 1;
+        num = 0;
+    }
+
+    // 空目录或读取失败时ents为NULL
+    if (num > 0)
+    {
+        qsort(ents, num, sizeof(dir_entry), cmp_dir_entry);
+    }
+
+    if (flags & DIR_LONG)
+    {
+        stat_entries(fd, ents, num);
+    }
+    for (int i = 0; i < num; i++)
+    {
+        if (flags & DIR_LONG)
+        {
+            format_entry(fd, &ents[i], out);
+        }
+        else
+        {
+            sb_append(out, ents[i].name, strlen(ents[i].name));
+            sb_append(out, "\n", 1);
+        }
+        dir_flush(out, DIR_BUF_SIZE);
+    }
+
+    // 递归列出子目录，不跟随符号链接
+    if (flags & DIR_RECURSIVE)
+    {
+        size_t path_len = strlen(path);
+        for (int i = 0; i < num; i++)
+        {
+            if (ents[i].type == DT_UNKNOWN && !ents[i].st_ok)
+            {
+                ents[i].st_ok = fstatat(fd, ents[i].name, &ents[i].st, AT_SYMLINK_NOFOLLOW) == 0;
+            }
+            if (ents[i].type != DT_DIR && !(ents[i].type == DT_UNKNOWN && ents[i].st_ok && S_ISDIR(ents[i].st.st_mode)))
+            {
+                continue;
+            }
+
+            size_t len = strlen(ents[i].name);
+            char *sub = (char *)malloc(path_len + len + 2);
+            sprintf(sub, path_len && path[path_len - 1] == '/' ? "%s%s" : "%s/%s", path, ents[i].name);
+            sb_append(out, "\n", 1);
+            sb_append(out, sub, strlen(sub));
+            sb_append(out, ":\n", 2);
+            result |= list_dir(sub, flags, out);
+            free(sub);
+        }
+    }
+
+    free(ents);
+    arena_free(&names);
+    close(fd);
+
+    return result;
+}
+
+// 以getdents64批量读取目录项，跳过.和..，文件名分配在names中
+// ents由realloc分配，返回数量，失败返回-1
+int read_dir(int fd, arena *names, dir_entry **ents)
+{
+    int num = 0;
+    int cap = 0;
+
+    char *buf = (char *)malloc(DIR_BUF_SIZE);
+    long got;
+    while ((got = syscall(SYS_getdents64, fd, buf, DIR_BUF_SIZE)) > 0)
+    {
+        for (long pos = 0; pos < got;)
+        {
+            dirent64_rec *d = (dirent64_rec *)(buf + pos);
+            pos += d->d_reclen;
+            if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0)
+            {
+                continue;
+            }
+            if (num == cap)
+            {
+                cap = cap ? cap * 2 : 256;
+                *ents = (dir_entry *)realloc(*ents, sizeof(dir_entry) * cap);
+            }
+            (*ents)[num].name = arena_strndup(names, d->d_name, strlen(d->d_name));
+            (*ents)[num].type = d->d_type;
+            (*ents)[num].st_ok = 0;
+            num++;
+        }
+    }
+    free(buf);
+
+    return got < 0 ? -1 : num;
+}
+
+// 取得各文件的属性，文件较多时分给几个线程并行fstatat
+void stat_entries(int dirfd, dir_entry *ents, int num)
+{
+    stat_part parts[DIR_STAT_THREADS];
+    int threads = num >= DIR_STAT_MIN ? DIR_STAT_THREADS : 1;
+    for (int i = 0; i < threads; i++)
+    {
+        parts[i].dirfd = dirfd;
+        parts[i].ents = ents;
+        parts[i].num = num;
+        parts[i].start = i;
+        parts[i].step = threads;
+    }
+
+    // 创建失败的部分由当前线程完成
+    pthread_t tids[DIR_STAT_THREADS];
+    int started[DIR_STAT_THREADS] = {0};
+    for (int i = 1; i < threads; i++)
+    {
+        started[i] = pthread_create(&tids[i], NULL, stat_worker, &parts[i]) == 0;
+    }
+    stat_worker(&parts[0]);
+    for (int i = 1; i < threads; i++)
+    {
+        if (started[i])
+        {
+            pthread_join(tids[i], NULL);
+        }
+        else
+        {
+            stat_worker(&parts[i]);
+        }
+    }
+}
+
+// 对分配到的文件调用fstatat
+void *stat_worker(void *arg)
+{
+    stat_part *p = (stat_part *)arg;
+    for (int i = p->start; i < p->num; i += p->step)
+    {
+        dir_entry *e = &p->ents[i];
+        e->st_ok = fstatat(p->dirfd, e->name, &e->st, AT_SYMLINK_NOFOLLOW) == 0;
+    }
+
+    return NULL;
+}
+
+// 以长格式写入单个文件：权限、大小、修改时间、文件名，符号链接附带目标
+void format_entry(int dirfd, dir_entry *e, strbuf *out)
+{
+    char line[128];
+    if (!e->st_ok)
+    {
+        sb_append(out, "?????????? ", 11);
+    }
+    else
+    {
+        mode_t m = e->st.st_mode;
+        char mode[12];
+        mode[0] = S_ISDIR(m) ? 'd' : S_ISLNK(m) ? 'l' : S_ISCHR(m) ? 'c' : S_ISBLK(m) ? 'b'
+                : S_ISFIFO(m) ? 'p' : S_ISSOCK(m) ? 's' : '-';
+        const char *rwx = "rwxrwxrwx";
+        for (int i = 0; i < 9; i++)
+        {
+            mode[i + 1] = (m & (0400 >> i)) ? rwx[i] : '-';
+        }
+        if (m & S_ISUID)
+        {
+            mode[3] = (m & S_IXUSR) ? 's' : 'S';
+        }
+        if (m & S_ISGID)
+        {
+            mode[6] = (m & S_IXGRP) ? 's' : 'S';
+        }
+        if (m & S_ISVTX)
+        {
+            mode[9] = (m & S_IXOTH) ? 't' : 'T';
+        }
+        mode[10] = '\0';
+
+        struct tm tm;
+        char when[32];
+        localtime_r(&e->st.st_mtime, &tm);
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M", &tm);
+
+        int len = snprintf(line, sizeof(line), "%s %10lld %s ", mode, (long long)e->st.st_size, when);
+        sb_append(out, line, len);
+    }
+    sb_append(out, e->name, strlen(e->name));
+
+    if (e->st_ok && S_ISLNK(e->st.st_mode))
+    {
+        char target[PATH_MAX];
+        ssize_t len = readlinkat(dirfd, e->name, target, sizeof(target));
+        if (len > 0)
+        {
+            sb_append(out, " -> ", 4);
+            sb_append(out, target, len);
+        }
+    }
+    sb_append(out, "\n", 1);
+}
+
+// 按文件名排序的比较函数
+int cmp_dir_entry(const void *a, const void *b)
+{
+    return strcmp(((dir_entry *)a)->name, ((dir_entry *)b)->name);
+}
+
+// 缓冲区超过limit时写出到stdout
+void dir_flush(strbuf *out, size_t limit)
+{
+    if (out->len > limit)
+    {
+        fwrite(out->s, 1, out->len, stdout);
+        out->len = 0;
+    }
+}
+
+// declare指令
+int declare(char **args)
+{
+    // 循环新增变量
+    for (int i = 1; args[i] != NULL; i++)
+    {
+        // 变量名
+        char *name = args[i];
+        // 变量值
+        char *value = strchr(args[i], '=');
+        if (value == NULL)
+        {
+            value = "";
+        }
+        else
+        {
+            *value++ = '\0';
+        }
+        // 设置变量
+        if (!valid_name(name, strlen(name)))
+        {
+            printf("declare: error argument \"%s=%s\"\n", name, value);
+            return 1;
+        }
+        set_var(name, value);
+    }
+
+    return 0;
+}
+
+// echo指令
+int echo(char **args)
+{
+    // 循环打印
+    for (int i = 1; args[i] != NULL; i++)
+    {
+        printf("%s ", args[i]);
+    }
+    printf("\n");
+
+    return 0;
+}
+
+// exec指令
+int exec(char **args)
+{
+    // 新增parent环境变量
+    char shell_path[PATH_MAX];
+    snprintf(shell_path, sizeof(shell_path), "%s/myshell", get_pwd());
+    export_var("parent", shell_path);
+
+    // 准备参数
+    char **argv = args + 1;
+
+    if (argv[0] == NULL)
+    {
+        return 0;
+    }
+
+    // 查找指令路径后调用execve，新程序从下一行继续读取输入
+    char path[PATH_MAX];
+    sync_reader(shell_input);
+    if (find_cmd(argv[0], path, sizeof(path)) || execve(path, argv, get_envp()) == -1)
+    {
+        printf("exec: execve error\n");
+    }
+
+    return 127;
+}
+
+// exit指令
+int my_exit(char **args)
+{
+    exit(args[1] ? atoi(args[1]) : last_status);
+}
+
+// export指令
+int export(char **args)
+{
+    // 无参数按名称顺序打印导出的变量
+    if (args[1] == NULL)
+    {
+        char **envp = get_envp();
+        int num = 0;
+        while (envp[num] != NULL)
+        {
+            num++;
+        }
+        char **sorted = (char **)arena_alloc(&line_arena, sizeof(char *) * (num + 1));
+        memcpy(sorted, envp, sizeof(char *) * num);
+        qsort(sorted, num, sizeof(char *), cmp_str);
+        for (int i = 0; i < num; i++)
+        {
+            printf("export %s\n", sorted[i]);
+        }
+        return 0;
+    }
+
+    int result = 0;
+    for (int i = 1; args[i] != NULL; i++)
+    {
+        char *value = strchr(args[i], '=');
+        size_t len = value ? (size_t)(value - args[i]) : strlen(args[i]);
+        if (!valid_name(args[i], len))
+        {
+            printf("export: error argument \"%s\"\n", args[i]);
+            result = 1;
+            continue;
+        }
+        if (value != NULL)
+        {
+            *value++ = '\0';
+        }
+        export_var(args[i], value);
+    }
+
+    return result;
+}
+
+// fg指令
+int fg(char **args)
+{
+    job *j = find_job(args[0], args[1]);
+    if (j == NULL)
+    {
+        return 1;
+    }
+
+    // 先交出终端，再让整个进程组继续
+    give_terminal(j);
+
+    // 继续执行
+    if (j->status == STAT_SUSPENDED)
+    {
+        // 发送信号
+        if (kill(-j->pid, SIGCONT) < 0)
+        {
+            printf("fg: send SINCONT error, pid: %d\n", j->pid);
+            take_terminal(NULL);
+            return 1;
+        }
+
+        // 更改job信息
+        j->status = STAT_CONTINUED;
+    }
+
+    j->is_fg = 1;
+    fg_job = j;
+    print_job_info(j);
+
+    // 等待子进程
+    return wait_fg(j, 0);
+}
+
+// help指令
+int help(char **args)
+{
+    // 总览
+    if (args[1] == NULL)
+    {
+        printf("myshell by dqrengg\n");
+        printf("support command:\n");
+        for (size_t i = 0; i < NUM_OF_CMD; i++)
+        {
+            printf("\t%s\n", buildin_list[i].name);
+        }
+        printf("use \"help [cmd]\" to get more info\n");
+    }
+    // 指令帮助
+    else
+    {
+        const buildin *b = get_cmd(args[1]);
+        if (b == NULL)
+        {
+            printf("help: error command\n");
+            return 1;
+        }
+        printf("usage: %s\n", b->usage);
+        printf("%s\n", b->desc);
+    }
+
+    return 0;
+}
+
+// jobs指令
+int jobs(char **args)
+{
+    // -v显示耗时及资源使用
+    int verbose = args[1] != NULL && strcmp(args[1], "-v") == 0;
+
+    // 循环打印，已结束的job显示一次后删除
+    job *next;
+    for (job *j = job_head; j; j = next)
+    {
+        next = j->next;
+        if (j->busy)
+        {
+            continue;
+        }
+        if (verbose)
+        {
+            print_job_usage(j);
+        }
+        else
+        {
+            print_job_info(j);
+        }
+
+        if (j->status == STAT_DONE)
+        {
+            del_job(j);
+        }
+    }
+    return 0;
+}
+
+// let指令，也用于((expr))
+int let(char **args)
+{
+    // ((之后的表达式可能展开为空
+    if (strcmp(args[0], "((") == 0)
+    {
+        long long value;
+        if (arith_eval(args[1] ? args[1] : "", &value))
+        {
+            return 1;
+        }
+        return value == 0;
+    }
+
+    if (args[1] == NULL)
+    {
+        printf("let: expression expected\n");
+        return 1;
+    }
+
+    // 以最后一个表达式的值为结果
+    long long value = 0;
+    for (int i = 1; args[i] != NULL; i++)
+    {
+        if (arith_eval(args[i], &value))
+        {
+            return 1;
+        }
+    }
+    return value == 0;
+}
+
+// 展开单词中的变量后计算，失败返回1
+int arith_word(const char *word, long long *result)
+{
+    // 不含变量及引号时直接计算
+    if (word[strcspn(word, "$'\"\\`")] == '\0')
+    {
+        return arith_eval(word, result);
+    }
+
+    char *expr = expand_word(word, 0);
+    if (expr == NULL)
+    {
+        return 1;
+    }
+    return arith_eval(expr, result);
+}
+
+// 计算64位整数表达式，运算符及优先级同C，失败返回1
+int arith_eval(const char *expr, long long *result)
+{
+    arith a = {expr, expr, 0, 0, 0};
+    // 空表达式为0
+    arith_space(&a);
+    if (*a.p == '\0')
+    {
+        *result = 0;
+        return 0;
+    }
+    *result = arith_comma(&a);
+    arith_space(&a);
+    if (!a.err && *a.p != '\0')
+    {
+        arith_error(&a, "syntax error in expression");
+    }
+    return a.err;
+}
+
+// 逗号表达式，取最后一个的值
+long long arith_comma(arith *a)
+{
+    long long value = arith_assign(a);
+    arith_space(a);
+    while (!a->err && *a->p == ',')
+    {
+        a->p++;
+        value = arith_assign(a);
+        arith_space(a);
+    }
+    return value;
+}
+
+// 赋值及条件表达式，均为右结合
+long long arith_assign(arith *a)
+{
+    arith_space(a);
+
+    // 变量名后紧跟赋值运算符
+    const char *start = a->p;
+    size_t len = 0;
+    while (isalnum((unsigned char)start[len]) || start[len] == '_')
+    {
+        len++;
+    }
+    if (len > 0 && !isdigit((unsigned char)*start))
+    {
+        const char *op = start + len;
+        while (*op == ' ' || *op == '\t' || *op == '\n')
+        {
+            op++;
+        }
+        // 复合赋值的运算符，长的在前
+        static const char *assign_ops[] = {"<<=", ">>=", "*=", "/=", "%=", "+=", "-=", "&=", "^=", "|=", "=", NULL};
+        for (int i = 0; assign_ops[i]; i++)
+        {
+            size_t op_len = strlen(assign_ops[i]);
+            if (strncmp(op, assign_ops[i], op_len) != 0 || (op_len == 1 && op[1] == '='))
+            {
+                continue;
+            }
+
+            char *name = arena_strndup(&line_arena, start, len);
+            a->p = op + op_len;
+            long long value = arith_assign(a);
+            if (op_len > 1)
+            {
+                char bin[3] = {op[0], op_len == 3 ? op[1] : '\0', '\0'};
+                value = arith_apply(a, bin, arith_get(a, name), value);
+            }
+            arith_set(a, name, value);
+            return value;
+        }
+    }
+
+    long long cond = arith_binary(a, 1);
+    arith_space(a);
+    if (a->err || *a->p != '?')
+    {
+        return cond;
+    }
+
+    // 只计算选中的分支
+    a->p++;
+    a->skip += !cond;
+    long long yes = arith_comma(a);
+    a->skip -= !cond;
+    arith_space(a);
+    if (*a->p != ':')
+    {
+        arith_error(a, "`:' expected for conditional expression");
+        return 0;
+    }
+    a->p++;
+    a->skip += !!cond;
+    long long no = arith_assign(a);
+    a->skip -= !!cond;
+    return cond ? yes : no;
+}
+
+// 按优先级爬升分析二元运算，只处理优先级不低于min的运算符
+long long arith_binary(arith *a, int min)
+{
+    long long lhs = arith_unary(a);
+    while (!a->err)
+    {
+        arith_space(a);
+        int prec;
+        const char *op = arith_op(a->p, &prec);
+        if (op == NULL || prec < min)
+        {
+            break;
+        }
+        a->p += strlen(op);
+
+        // &&和||短路，右边只检查语法
+        if (strcmp(op, "&&") == 0 || strcmp(op, "||") == 0)
+        {
+            int skip = (op[0] == '&') ? lhs == 0 : lhs != 0;
+            a->skip += skip;
+            long long rhs = arith_binary(a, prec + 1);
+            a->skip -= skip;
+            lhs = (op[0] == '&') ? (lhs && rhs) : (lhs || rhs);
+            continue;
+        }
+
+        // **为右结合
+        long long rhs = arith_binary(a, strcmp(op, "**") == 0 ? prec : prec + 1);
+        lhs = arith_apply(a, op, lhs, rhs);
+    }
+    return lhs;
+}
+
+// 取得p处的二元运算符及其优先级，不是二元运算符或为复合赋值时返回NULL
+const char *arith_op(const char *p, int *prec)
+{
+    static const struct
+    {
+        const char *op;
+        int prec;
+    } ops[] = {
+        {"||", 1}, {"&&", 2}, {"==", 6}, {"!=", 6}, {"<=", 7}, {">=", 7}, {"<<", 8}, {">>", 8}, {"**", 11},
+        {"|", 3}, {"^", 4}, {"&", 5}, {"<", 7}, {">", 7}, {"+", 9}, {"-", 9}, {"*", 10}, {"/", 10}, {"%", 10},
+    };
+
+    if (*p == '\0' || !strchr("|&=!<>*+-/%^", *p))
+    {
+        return NULL;
+    }
+    for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++)
+    {
+        size_t len = strlen(ops[i].op);
+        if (strncmp(p, ops[i].op, len) != 0)
+        {
+            continue;
+        }
+        // 比较运算符之外的运算符后跟=为复合赋值
+        if (p[len] == '=' && ops[i].prec != 6 && ops[i].prec != 7)
+        {
+            return NULL;
+        }
+        *prec = ops[i].prec;
+        return ops[i].op;
+    }
+    return NULL;
+}
+
+// 计算二元运算，按64位补码回绕
+long long arith_apply(arith *a, const char *op, long long l, long long r)
+{
+    unsigned long long ul = l;
+    unsigned long long ur = r;
+
+    switch (op[0])
+    {
+    case '+':
+        return (long long)(ul + ur);
+    case '-':
+        return (long long)(ul - ur);
+    case '*':
+        if (op[1] == '*')
+        {
+            if (r < 0)
+            {
+                arith_error(a, "exponent less than 0");
+                return 0;
+            }
+            unsigned long long result = 1;
+            for (; r > 0; r >>= 1, ul *= ul)
+            {
+                if (r & 1)
+                {
+                    result *= ul;
+                }
+            }
+            return (long long)result;
+        }
+        return (long long)(ul * ur);
+    case '/':
+    case '%':
+        if (r == 0)
+        {
+            // 短路未选中的部分不报错
+            if (!a->skip)
+            {
+                arith_error(a, "division by 0");
+            }
+            return 0;
+        }
+        // LLONG_MIN / -1溢出
+        if (r == -1)
+        {
+            return op[0] == '/' ? (long long)(0 - ul) : 0;
+        }
+        return op[0] == '/' ? l / r : l % r;
+    case '<':
+        if (op[1] == '<')
+        {
+            return (long long)(ul << (ur & 63));
+        }
+        return op[1] == '=' ? l <= r : l < r;
+    case '>':
+        if (op[1] == '>')
+        {
+            return l >> (ur & 63);
+        }
+        return op[1] == '=' ? l >= r : l > r;
+    case '=':
+        return l == r;
+    case '!':
+        return l != r;
+    case '&':
+        return l & r;
+    case '^':
+        return l ^ r;
+    case '|':
+        return l | r;
+    }
+
+    return 0;
+}
+
+// 一元运算及前缀、后缀的++和--
+long long arith_unary(arith *a)
+{
+    arith_space(a);
+    const char *p = a->p;
+
+    // ++name及--name
+    if ((p[0] == '+' || p[0] == '-') && p[1] == p[0])
+    {
+        const char *name = p + 2;
+        while (*name == ' ' || *name == '\t')
+        {
+            name++;
+        }
+        size_t len = 0;
+        while (isalnum((unsigned char)name[len]) || name[len] == '_')
+        {
+            len++;
+        }
+        if (len > 0 && !isdigit((unsigned char)*name))
+        {
+            char *var_name = arena_strndup(&line_arena, name, len);
+            a->p = name + len;
+            long long value = arith_get(a, var_name) + (p[0] == '+' ? 1 : -1);
+            arith_set(a, var_name, value);
+            return value;
+        }
+    }
+
+    switch (*p)
+    {
+    case '!':
+        a->p++;
+        return !arith_unary(a);
+    case '~':
+        a->p++;
+        return ~arith_unary(a);
+    case '-':
+        a->p++;
+        return (long long)(0 - (unsigned long long)arith_unary(a));
+    case '+':
+        a->p++;
+        return arith_unary(a);
+    }
+
+    return arith_operand(a);
+}
+
+// 数字、变量或括号中的表达式
+long long arith_operand(arith *a)
+{
+    arith_space(a);
+    const char *p = a->p;
+
+    if (*p == '(')
+    {
+        a->p++;
+        long long value = arith_comma(a);
+        arith_space(a);
+        if (*a->p != ')')
+        {
+            arith_error(a, "missing `)'");
+            return 0;
+        }
+        a->p++;
+        return value;
+    }
+
+    // 变量，可以后跟++或--
+    if (isalpha((unsigned char)*p) || *p == '_')
+    {
+        size_t len = 0;
+        while (isalnum((unsigned char)p[len]) || p[len] == '_')
+        {
+            len++;
+        }
+        char *name = arena_strndup(&line_arena, p, len);
+        a->p = p + len;
+        long long value = arith_get(a, name);
+
+        arith_space(a);
+        if ((a->p[0] == '+' || a->p[0] == '-') && a->p[1] == a->p[0])
+        {
+            arith_set(a, name, value + (a->p[0] == '+' ? 1 : -1));
+            a->p += 2;
+        }
+        return value;
+    }
+
+    if (isdigit((unsigned char)*p))
+    {
+        return arith_number(a);
+    }
+
+    arith_error(a, *p ? "syntax error: operand expected" : "syntax error: operand expected (end of expression)");
+    return 0;
+}
+
+// 数字，支持0x十六进制、0八进制及base#n，base为2到64
+long long arith_number(arith *a)
+{
+    const char *p = a->p;
+    int base = 10;
+
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+    {
+        base = 16;
+        p += 2;
+    }
+    else if (p[0] == '0')
+    {
+        base = 8;
+    }
+    else
+    {
+        const char *hash = p;
+        while (isdigit((unsigned char)*hash))
+        {
+            hash++;
+        }
+        if (*hash == '#')
+        {
+            base = atoi(p);
+            if (base < 2 || base > 64)
+            {
+                arith_error(a, "invalid arithmetic base");
+                return 0;
+            }
+            p = hash + 1;
+        }
+    }
+
+    // 10-35为a-z，36-61为A-Z，base不大于36时不区分大小写，之后为@和_
+    unsigned long long value = 0;
+    const char *start = p;
+    while (1)
+    {
+        int d;
+        if (isdigit((unsigned char)*p))
+        {
+            d = *p - '0';
+        }
+        else if (islower((unsigned char)*p))
+        {
+            d = *p - 'a' + 10;
+        }
+        else if (isupper((unsigned char)*p))
+        {
+            d = *p - 'A' + (base <= 36 ? 10 : 36);
+        }
+        else if (*p == '@' || *p == '_')
+        {
+            d = *p == '@' ? 62 : 63;
+        }
+        else
+        {
+            break;
+        }
+        if (d >= base)
+        {
+            arith_error(a, "value too great for base");
+            return 0;
+        }
+        value = value * base + d;
+        p++;
+    }
+    if (p == start && base != 8)
+    {
+        arith_error(a, "invalid number");
+        return 0;
+    }
+
+    a->p = p;
+    return (long long)value;
+}
+
+// 取得变量的值，未设置或为空时为0，值不是数字时作为表达式计算
+long long arith_get(arith *a, const char *name)
+{
+    char *value = get_var(name);
+    if (value == NULL || *value == '\0')
+    {
+        return 0;
+    }
+
+    // 十进制数字直接转换
+    char *end;
+    errno = 0;
+    long long n = strtoll(value, &end, 10);
+    if (*end == '\0' && errno == 0 && (value[0] != '0' || value[1] == '\0'))
+    {
+        return n;
+    }
+
+    if (a->depth >= ARITH_DEPTH_MAX)
+    {
+        arith_error(a, "expression recursion level exceeded");
+        return 0;
+    }
+    arith sub = {value, value, 0, a->skip, a->depth + 1};
+    n = arith_comma(&sub);
+    arith_space(&sub);
+    if (!sub.err && *sub.p != '\0')
+    {
+        arith_error(&sub, "syntax error in expression");
+    }
+    a->err |= sub.err;
+    return n;
+}
+
+// 设置变量为整数值，短路未选中的部分不赋值
+void arith_set(arith *a, const char *name, long long value)
+{
+    if (a->skip || a->err)
+    {
+        return;
+    }
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%lld", value);
+    set_var(name, buf);
+}
+
+// 跳过空白
+void arith_space(arith *a)
+{
+    while (*a->p == ' ' || *a->p == '\t' || *a->p == '\n')
+    {
+        a->p++;
+    }
+}
+
+// 报告错误，只报告第一个
+void arith_error(arith *a, const char *msg)
+{
+    if (a->err)
+    {
+        return;
+    }
+    a->err = 1;
+    if (*a->p)
+    {
+        printf("myshell: %s: %s (error token is \"%s\")\n", a->expr, msg, a->p);
+    }
+    else
+    {
+        printf("myshell: %s: %s\n", a->expr, msg);
+    }
+}
+
+// local指令
+int local(char **args)
+{
+    if (cur_frame == NULL)
+    {
+        printf("local: can only be used in a function\n");
+        return 1;
+    }
+
+    int result = 0;
+    for (int i = 1; args[i] != NULL; i++)
+    {
+        char *name = args[i];
+        char *value = strchr(args[i], '=');
+        if (value != NULL)
+        {
+            *value++ = '\0';
+        }
+        if (!valid_name(name, strlen(name)))
+        {
+            printf("local: error argument \"%s\"\n", name);
+            result = 1;
+            continue;
+        }
+
+        // 同一次调用中只保存第一次声明前的值
+        local_var *l = cur_frame->locals;
+        while (l != NULL && strcmp(l->name, name) != 0)
+        {
+            l = l->next;
+        }
+        if (l == NULL)
+        {
+            var *v = find_var(name);
+            l = (local_var *)malloc(sizeof(local_var));
+            l->name = strdup(name);
+            l->value = v ? strdup(v->value) : NULL;
+            l->exported = v ? v->exported : 0;
+            l->next = cur_frame->locals;
+            cur_frame->locals = l;
+        }
+        set_var(name, value ? value : "");
+    }
+
+    return result;
+}
+
+// parallel指令
+int parallel(char **args)
+{
+    int max_jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int keep_order = 0;
+    int i = 1;
+
+    // 选项
+    for (; args[i] != NULL && args[i][0] == '-'; i++)
+    {
+        if (strcmp(args[i], "-k") == 0)
+        {
+            keep_order = 1;
+        }
+        else if (strncmp(args[i], "-j", 2) == 0)
+        {
+            char *n = args[i][2] ? args[i] + 2 : args[++i];
+            if (n == NULL || (max_jobs = atoi(n)) <= 0)
+            {
+                printf("parallel: error job number: %s\n", n ? n : "");
+                return 1;
+            }
+        }
+        else
+        {
+            printf("parallel: error option: %s\n", args[i]);
+            return 1;
+        }
+    }
+    if (max_jobs <= 0)
+    {
+        max_jobs = 1;
+    }
+
+    // 指令及参数
+    char **cmd = args + i;
+    int cmd_num = 0;
+    while (cmd[cmd_num] != NULL && strcmp(cmd[cmd_num], ":::") != 0)
+    {
+        cmd_num++;
+    }
+    if (cmd_num == 0)
+    {
+        printf("parallel: missing command\n");
+        return 1;
+    }
+
+    // 参数在:::之后，否则从标准输入逐行读取
+    char **items;
+    int item_num = 0;
+    if (cmd[cmd_num] != NULL)
+    {
+        items = cmd + cmd_num + 1;
+        while (items[item_num] != NULL)
+        {
+            item_num++;
+        }
+    }
+    else
+    {
+        int cap = 64;
+        items = (char **)arena_alloc(&line_arena, sizeof(char *) * cap);
+        reader r;
+        sync_reader(shell_input);
+        init_reader(&r, STDIN_FILENO, NULL);
+        char *line;
+        while ((line = read_line(&r)) != NULL)
+        {
+            if (*line == '\0')
+            {
+                continue;
+            }
+            if (item_num == cap)
+            {
+                char **bigger = (char **)arena_alloc(&line_arena, sizeof(char *) * cap * 2);
+                memcpy(bigger, items, sizeof(char *) * cap);
+                items = bigger;
+                cap *= 2;
+            }
+            items[item_num++] = arena_strndup(&line_arena, line, strlen(line));
+        }
+        free(r.buf);
+        free(r.line);
+    }
+
+    // 生成任务，含{}的参数替换为arg，否则把arg接在最后
+    task *tasks = (task *)arena_alloc(&line_arena, sizeof(task) * (item_num ? item_num : 1));
+    for (int t = 0; t < item_num; t++)
+    {
+        char **targs = (char **)arena_alloc(&line_arena, sizeof(char *) * (cmd_num + 2));
+        int n = 0;
+        int replaced = 0;
+        for (int k = 0; k < cmd_num; k++)
+        {
+            char *p = strstr(cmd[k], "{}");
+            if (p == NULL)
+            {
+                targs[n++] = cmd[k];
+                continue;
+            }
+
+            strbuf sb = {NULL, 0, 0};
+            char *s = cmd[k];
+            for (; p != NULL; s = p + 2, p = strstr(s, "{}"))
+            {
+                sb_append(&sb, s, p - s);
+                sb_append(&sb, items[t], strlen(items[t]));
+            }
+            sb_append(&sb, s, strlen(s));
+            targs[n++] = arena_strndup(&line_arena, sb.s, sb.len);
+            free(sb.s);
+            replaced = 1;
+        }
+        if (!replaced)
+        {
+            targs[n++] = items[t];
+        }
+        targs[n] = NULL;
+
+        tasks[t].args = targs;
+        tasks[t].pid = -1;
+        tasks[t].fd = -1;
+        tasks[t].done = 0;
+        tasks[t].j = NULL;
+        tasks[t].out = (strbuf){NULL, 0, 0};
+    }
+
+    // 保持n个任务同时运行，按完成顺序或输入顺序写出输出
+    struct pollfd *fds = (struct pollfd *)arena_alloc(&line_arena, sizeof(struct pollfd) * max_jobs);
+    int *running = (int *)arena_alloc(&line_arena, sizeof(int) * max_jobs);
+    int run_num = 0;
+    int next = 0;
+    int next_out = 0;
+    int failed = 0;
+    int stop = 0;
+
+    fflush(stdout);
+    while (next < item_num || run_num > 0)
+    {
+        // 补足空闲的worker
+        while (!stop && run_num < max_jobs && next < item_num)
+        {
+            task *t = &tasks[next++];
+            if (spawn_task(t) < 0)
+            {
+                t->done = 1;
+                failed++;
+                continue;
+            }
+            running[run_num++] = t - tasks;
+        }
+        if (run_num == 0)
+        {
+            break;
+        }
+
+        for (int k = 0; k < run_num; k++)
+        {
+            fds[k].fd = tasks[running[k]].fd;
+            fds[k].events = POLLIN;
+            fds[k].revents = 0;
+        }
+        if (poll(fds, run_num, -1) < 0 && errno != EINTR)
+        {
+            break;
+        }
+
+        // ctrl+c不再启动新任务，并中断正在运行的任务
+        if (sig_pending[SIGINT])
+        {
+            sig_pending[SIGINT] = 0;
+            stop = 1;
+            for (int k = 0; k < run_num; k++)
+            {
+                kill(tasks[running[k]].pid, SIGINT);
+            }
+        }
+
+        // 读取输出，读完即回收该任务
+        for (int k = 0; k < run_num; k++)
+        {
+            if (fds[k].revents == 0)
+            {
+                continue;
+            }
+
+            task *t = &tasks[running[k]];
+            char buf[4096];
+            ssize_t got = read(t->fd, buf, sizeof(buf));
+            if (got > 0)
+            {
+                sb_append(&t->out, buf, got);
+                continue;
+            }
+            if (got < 0 && errno == EINTR)
+            {
+                continue;
+            }
+
+            finish_task(t);
+            if (t->j->exit_status != 0)
+            {
+                failed++;
+            }
+            if (!keep_order)
+            {
+                fwrite(t->out.s ? t->out.s : "", 1, t->out.len, stdout);
+                fflush(stdout);
+            }
+
+            running[k] = running[--run_num];
+            fds[k] = fds[run_num];
+            k--;
+        }
+
+        // 按输入顺序写出已完成的任务
+        while (keep_order && next_out < next && tasks[next_out].done)
+        {
+            fwrite(tasks[next_out].out.s ? tasks[next_out].out.s : "", 1, tasks[next_out].out.len, stdout);
+            next_out++;
+        }
+        fflush(stdout);
+    }
+
+    for (int t = 0; t < item_num; t++)
+    {
+        free(tasks[t].out.s);
+    }
+
+    // 与GNU parallel相同，返回失败的任务数
+    return failed > 101 ? 101 : failed;
+}
+
+// 启动parallel任务，输出接到管道，并登记到job表
+pid_t spawn_task(task *t)
+{
+    int fd[2];
+    if (pipe(fd) < 0)
+    {
+        printf("pipe error\n");
+        return -1;
+    }
+    // 避免其它任务继承管道
+    fcntl(fd[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fd[1], F_SETFD, FD_CLOEXEC);
+
+    pid_t pid;
+    if (get_cmd(t->args[0]) == NULL)
+    {
+        command c = {t->args, 0, NULL, NULL};
+        pid = spawn_cmd(&c, t->args, STDIN_FILENO, fd[1], NULL, 0, -1);
+    }
+    // build in指令
+    else
+    {
+        fflush(stdout);
+        if ((pid = fork()) == 0)
+        {
+            init_child(-1, 0);
+            dup2(fd[1], STDOUT_FILENO);
+            exit(handle_cmd(t->args));
+        }
+    }
+    close(fd[1]);
+
+    if (pid < 0)
+    {
+        close(fd[0]);
+        return -1;
+    }
+
+    // 任务命令行
+    strbuf sb = {NULL, 0, 0};
+    for (int k = 0; t->args[k] != NULL; k++)
+    {
+        if (k)
+        {
+            sb_append(&sb, " ", 1);
+        }
+        sb_append(&sb, t->args[k], strlen(t->args[k]));
+    }
+    t->j = add_job(sb.s, 1, 0);
+    add_proc(t->j, 0, pid, t->args[0]);
+    free(sb.s);
+
+    t->pid = pid;
+    t->fd = fd[0];
+    return pid;
+}
+
+// 任务输出结束，回收进程并记录退出状态及资源使用
+void finish_task(task *t)
+{
+    int st = 0;
+    struct rusage usage;
+    close(t->fd);
+    t->fd = -1;
+
+    memset(&usage, 0, sizeof(usage));
+    while (wait4(t->pid, &st, 0, &usage) < 0 && errno == EINTR)
+        ;
+    proc_exit(&t->j->procs[0], st, &usage);
+    update_job(t->j);
+    t->done = 1;
+}
+
+// pwd指令
+int pwd(char **args)
+{
+    printf("%s\n", get_pwd());
+
+    return 0;
+}
+
+// return指令
+int my_return(char **args)
+{
+    if (cur_frame == NULL)
+    {
+        printf("return: can only return from a function\n");
+        return 1;
+    }
+
+    return_status = (args[1] ? atoi(args[1]) : last_status) & 0xff;
+    func_return = 1;
+    return return_status;
+}
+
+// set指令
+int set(char **args)
+{
+    // 无参数按名称顺序打印全部变量
+    if (args[1] == NULL)
+    {
+        int num = 0;
+        for (int i = 0; i < VAR_HASH_SIZE; i++)
+        {
+            for (var *v = var_hash[i]; v; v = v->next)
+            {
+                num++;
+            }
+        }
+        var **vars = (var **)arena_alloc(&line_arena, sizeof(var *) * (num + 1));
+        num = 0;
+        for (int i = 0; i < VAR_HASH_SIZE; i++)
+        {
+            for (var *v = var_hash[i]; v; v = v->next)
+            {
+                vars[num++] = v;
+            }
+        }
+        qsort(vars, num, sizeof(var *), cmp_var);
+        for (int i = 0; i < num; i++)
+        {
+            printf("%s=%s\n", vars[i]->name, vars[i]->value);
+        }
+    }
+    // 有参数更新位置参数，--之后的参数均为位置参数
+    else
+    {
+        args += (strcmp(args[1], "--") == 0) ? 2 : 1;
+        int num = 0;
+        while (args[num] != NULL)
+        {
+            num++;
+        }
+        set_pos_args(args, num);
+    }
+
+    return 0;
+}
+
+// shift指令
+int shift(char **args)
+{
+    int time;
+
+    // 无参数等于shift 1
+    if (args[1] == NULL)
+    {
+        time = 1;
+    }
+    else if ((time = atoi(args[1])) == 0)
+    {
+        printf("set: error argument \"%s\"\n", args[1]);
+        return 1;
+    }
+
+    if (time < 0 || time > pos_num)
+    {
+        printf("shift: %d: shift count out of range\n", time);
+        return 1;
+    }
+
+    // 平移位置参数
+    for (int i = 0; i < time; i++)
+    {
+        free(pos_args[i]);
+    }
+    memmove(pos_args, pos_args + time, sizeof(char *) * (pos_num - time + 1));
+    pos_num -= time;
+
+    return 0;
+}
+
+
+// test及[指令，结果为退出码，真为0，假为1，语法错误为2
+int test(char **args)
+{
+    test_state ts;
+    memset(&ts, 0, sizeof(ts));
+    ts.args = args + 1;
+    while (ts.args[ts.num] != NULL)
+    {
+        ts.num++;
+    }
+
+    // [须以]结尾
+    if (strcmp(args[0], "[") == 0)
+    {
+        if (ts.num == 0 || strcmp(ts.args[ts.num - 1], "]") != 0)
+        {
+            printf("[: missing \"]\"\n");
+            return 2;
+        }
+        ts.num--;
+    }
+
+    return test_eval(&ts, args[0]);
+}
+
+// 条件指令[[ expr ]]，单词不分割，==和!=右侧加引号的部分按字面比较
+int run_cond(node *n)
+{
+    test_state ts;
+    memset(&ts, 0, sizeof(ts));
+    ts.args = n->words;
+    ts.num = n->word_num;
+    ts.cond = 1;
+    return test_eval(&ts, "[[");
+}
+
+// 对ts中的参数求值，返回退出码
+int test_eval(test_state *ts, const char *name)
+{
+    // 没有参数为假
+    if (ts->num == 0)
+    {
+        return 1;
+    }
+
+    int result = test_or(ts);
+    if (!ts->err && ts->pos < ts->num)
+    {
+        printf("%s: unexpected \"%s\"\n", name, ts->args[ts->pos]);
+        ts->err = 1;
+    }
+    if (ts->err)
+    {
+        return 2;
+    }
+    return !result;
+}
+
+// expr -o expr，[[中为expr || expr，结果已确定时只检查右侧的语法
+int test_or(test_state *ts)
+{
+    const char *op = ts->cond ? "||" : "-o";
+    int result = test_and(ts);
+    while (!ts->err && ts->pos < ts->num && strcmp(ts->args[ts->pos], op) == 0)
+    {
+        ts->pos++;
+        ts->skip += result;
+        int right = test_and(ts);
+        ts->skip -= result;
+        result = result || right;
+    }
+    return result;
+}
+
+// expr -a expr，[[中为expr && expr
+int test_and(test_state *ts)
+{
+    const char *op = ts->cond ? "&&" : "-a";
+    int result = test_not(ts);
+    while (!ts->err && ts->pos < ts->num && strcmp(ts->args[ts->pos], op) == 0)
+    {
+        ts->pos++;
+        ts->skip += !result;
+        int right = test_not(ts);
+        ts->skip -= !result;
+        result = result && right;
+    }
+    return result;
+}
+
+// ! expr，后面只剩一个参数时!为普通字符串
+int test_not(test_state *ts)
+{
+    if (ts->pos + 1 < ts->num && strcmp(ts->args[ts->pos], "!") == 0)
+    {
+        ts->pos++;
+        return !test_not(ts);
+    }
+    return test_primary(ts);
+}
+
+// 括号、二元及一元表达式，或单个字符串
+int test_primary(test_state *ts)
+{
+    if (ts->pos >= ts->num)
+    {
+        printf("test: argument expected\n");
+        ts->err = 1;
+        return 0;
+    }
+
+    char **a = ts->args + ts->pos;
+    int left = ts->num - ts->pos;
+
+    // 二元运算优先，使[ -f = -f ]等按字符串比较
+    if (left >= 3 && is_binary_op(a[1]))
+    {
+        ts->pos += 3;
+        int pattern = ts->cond && (strcmp(a[1], "=") == 0 || strcmp(a[1], "==") == 0 || strcmp(a[1], "!=") == 0);
+        char *x = test_word(ts, a[0], 0);
+        char *y = test_word(ts, a[2], pattern);
+        if (x == NULL || y == NULL || ts->skip)
+        {
+            return 0;
+        }
+        return test_binary(ts, x, a[1], y);
+    }
+    if (strcmp(a[0], "(") == 0 && left >= 2)
+    {
+        ts->pos++;
+        int result = test_or(ts);
+        if (ts->pos >= ts->num || strcmp(ts->args[ts->pos], ")") != 0)
+        {
+            if (!ts->err)
+            {
+                printf("test: missing \")\"\n");
+            }
+            ts->err = 1;
+            return 0;
+        }
+        ts->pos++;
+        return result;
+    }
+    if (left >= 2 && is_unary_op(a[0]))
+    {
+        ts->pos += 2;
+        char *x = test_word(ts, a[1], 0);
+        if (x == NULL || ts->skip)
+        {
+            return 0;
+        }
+        return test_unary(ts, a[0], x);
+    }
+
+    // 非空字符串为真
+    ts->pos++;
+    char *x = test_word(ts, a[0], 0);
+    return x != NULL && x[0] != '\0';
+}
+
+// 取得运算数，[[中的单词在此展开，pattern时右侧引号中的特殊字符加反斜杠，失败返回NULL
+char *test_word(test_state *ts, const char *word, int pattern)
+{
+    if (!ts->cond || ts->skip)
+    {
+        return (char *)word;
+    }
+    if (!pattern)
+    {
+        char *s = expand_word(word, 0);
+        ts->err |= s == NULL;
+        return s;
+    }
+
+    fieldlist f = {0};
+    f.pattern = 1;
+    int err = expand_into(&f, word, 0);
+    char *s = arena_strndup(&line_arena, f.pat.s ? f.pat.s : "", f.pat.len);
+    free(f.cur.s);
+    free(f.pat.s);
+    ts->err |= err;
+    return err ? NULL : s;
+}
+
+// 一元运算
+int test_unary(test_state *ts, const char *op, const char *arg)
+{
+    char c = op[1];
+
+    // 字符串
+    if (c == 'z')
+    {
+        return arg[0] == '\0';
+    }
+    if (c == 'n')
+    {
+        return arg[0] != '\0';
+    }
+    // fd是否为终端
+    if (c == 't')
+    {
+        return isatty((int)test_int(ts, arg));
+    }
+
+    // 文件，-L、-h不跟随符号链接
+    struct stat *st = test_get_stat(ts, arg, c != 'L' && c != 'h');
+    if (st == NULL)
+    {
+        return 0;
+    }
+    switch (c)
+    {
+    case 'e':
+        return 1;
+    case 'f':
+        return S_ISREG(st->st_mode);
+    case 'd':
+        return S_ISDIR(st->st_mode);
+    case 'L':
+    case 'h':
+        return S_ISLNK(st->st_mode);
+    case 'p':
+        return S_ISFIFO(st->st_mode);
+    case 'S':
+        return S_ISSOCK(st->st_mode);
+    case 'b':
+        return S_ISBLK(st->st_mode);
+    case 'c':
+        return S_ISCHR(st->st_mode);
+    case 's':
+        return st->st_size > 0;
+    case 'u':
+        return (st->st_mode & S_ISUID) != 0;
+    case 'g':
+        return (st->st_mode & S_ISGID) != 0;
+    case 'k':
+        return (st->st_mode & S_ISVTX) != 0;
+    case 'r':
+        return test_access(st, R_OK);
+    case 'w':
+        return test_access(st, W_OK);
+    case 'x':
+        return test_access(st, X_OK);
+    }
+    return 0;
+}
+
+// 二元运算
+int test_binary(test_state *ts, const char *a, const char *op, const char *b)
+{
+    // 字符串比较，[[中按模式匹配右侧
+    if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0 || strcmp(op, "!=") == 0)
+    {
+        int eq;
+        if (ts->cond)
+        {
+            eq = glob_match(b, b + strlen(b), a);
+        }
+        else
+        {
+            eq = strcmp(a, b) == 0;
+        }
+        return op[0] == '!' ? !eq : eq;
+    }
+    if (strcmp(op, "<") == 0)
+    {
+        return strcmp(a, b) < 0;
+    }
+    if (strcmp(op, ">") == 0)
+    {
+        return strcmp(a, b) > 0;
+    }
+
+    // 文件比较
+    if (strcmp(op, "-nt") == 0 || strcmp(op, "-ot") == 0 || strcmp(op, "-ef") == 0)
+    {
+        struct stat *sa = test_get_stat(ts, a, 1);
+        struct stat *sb = test_get_stat(ts, b, 1);
+        if (op[1] == 'e')
+        {
+            return sa && sb && sa->st_dev == sb->st_dev && sa->st_ino == sb->st_ino;
+        }
+        // 不存在的文件比任何存在的文件旧
+        if (sa == NULL || sb == NULL)
+        {
+            return op[1] == 'n' ? sa != NULL : sb != NULL;
+        }
+        struct timespec ta = sa->st_mtim;
+        struct timespec tb = sb->st_mtim;
+        int cmp = (ta.tv_sec != tb.tv_sec) ? (ta.tv_sec > tb.tv_sec ? 1 : -1)
+                : (ta.tv_nsec != tb.tv_nsec) ? (ta.tv_nsec > tb.tv_nsec ? 1 : -1) : 0;
+        return op[1] == 'n' ? cmp > 0 : cmp < 0;
+    }
+
+    // 整数比较
+    long long x = test_int(ts, a);
+    long long y = test_int(ts, b);
+    if (ts->err)
+    {
+        return 0;
+    }
+    switch (op[1] * 256 + op[2])
+    {
+    case 'e' * 256 + 'q':
+        return x == y;
+    case 'n' * 256 + 'e':
+        return x != y;
+    case 'l' * 256 + 't':
+        return x < y;
+    case 'l' * 256 + 'e':
+        return x <= y;
+    case 'g' * 256 + 't':
+        return x > y;
+    default:
+        return x >= y;
+    }
+}
+
+// 是否为一元运算符
+int is_unary_op(const char *op)
+{
+    return op[0] == '-' && op[1] != '\0' && op[2] == '\0' && strchr("zntefdLhpSbcsugkrwx", op[1]);
+}
+
+// 是否为二元运算符
+int is_binary_op(const char *op)
+{
+    static const char *ops[] =
+    {
+        "=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le", "-gt", "-ge", "-nt", "-ot", "-ef",
+    };
+    for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++)
+    {
+        if (strcmp(op, ops[i]) == 0)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 取得文件属性，同一表达式中相同的文件只stat一次，不存在返回NULL
+struct stat *test_get_stat(test_state *ts, const char *path, int follow)
+{
+    for (int i = 0; i < ts->cache_num; i++)
+    {
+        test_stat *t = &ts->cache[i];
+        if (t->follow == follow && strcmp(t->path, path) == 0)
+        {
+            return t->ok ? &t->st : NULL;
+        }
+    }
+
+    // 缓存已满时覆盖最后一项
+    test_stat *t = &ts->cache[ts->cache_num < TEST_STAT_MAX ? ts->cache_num++ : TEST_STAT_MAX - 1];
+    t->path = path;
+    t->follow = follow;
+    t->ok = (follow ? stat(path, &t->st) : lstat(path, &t->st)) == 0;
+    return t->ok ? &t->st : NULL;
+}
+
+// 按有效用户及组检查权限，root可读写任何文件，有任一执行位时可执行
+int test_access(struct stat *st, int mode)
+{
+    uid_t euid = geteuid();
+    if (euid == 0)
+    {
+        return mode != X_OK || (st->st_mode & (S_IXUSR | S_IXGRP | S_IXOTH)) || S_ISDIR(st->st_mode);
+    }
+
+    int shift = 0;
+    if (st->st_uid == euid)
+    {
+        shift = 6;
+    }
+    else
+    {
+        int in_group = st->st_gid == getegid();
+        if (!in_group)
+        {
+            int n = getgroups(0, NULL);
+            gid_t *groups = (gid_t *)arena_alloc(&line_arena, sizeof(gid_t) * (n > 0 ? n : 1));
+            n = getgroups(n, groups);
+            for (int i = 0; i < n && !in_group; i++)
+            {
+                in_group = groups[i] == st->st_gid;
+            }
+        }
+        shift = in_group ? 3 : 0;
+    }
+    return (st->st_mode >> shift) & mode;
+}
+
+// 解析整数，失败时报告语法错误
+long long test_int(test_state *ts, const char *s)
+{
+    char *end;
+    errno = 0;
+    long long n = strtoll(s, &end, 10);
+    while (*end == ' ' || *end == '\t')
+    {
+        end++;
+    }
+    if (*s == '\0' || *end != '\0' || errno == ERANGE)
+    {
+        if (!ts->err)
+        {
+            printf("test: %s: integer expression expected\n", s);
+        }
+        ts->err = 1;
+        return 0;
+    }
+    return n;
+}
+
+// time指令
+int my_time(char **args)
+{
+    time_t timep;
+    time(&timep);
+    printf("%s", ctime(&timep));
+    return 0;
+}
+
+// umask指令
+int my_umask(char **args)
+{
+    // 无参数，显示目前mask
+    if (args[1] == NULL)
+    {
+        unsigned int mask;
+        umask((mask = umask(0)));
+        printf("%04o\n", mask);
+    }
+    // 有参数，更新mask
+    else
+    {
+        unsigned int mask = 0;
+        int i = 0;
+        while (args[1][i] != '\0')
+        {
+            mask = mask * 8 + (args[1][i] - '0');
+            i++;
+        }
+
+        umask(mask);
+    }
+
+    return 0;
+}
+
+// unset指令
+int unset(char **args)
+{
+    int result = 0;
+
+    // 删除shell变量及环境变量
+    for (int i = 1; args[i] != NULL; i++)
+    {
+        if (!valid_name(args[i], strlen(args[i])))
+        {
+            printf("set: error argument \"%s\"\n", args[i]);
+            result = 1;
+        }
+        else
+        {
+            unset_var(args[i]);
+        }
+    }
+
+    return result;
+}
+
+// hash指令
+int hash(char **args)
+{
+    char path[PATH_MAX];
+    int result = 0;
+
+    // 无参数，列出缓存
+    if (args[1] == NULL)
+    {
+        int empty = 1;
+        for (int i = 0; i < PATH_HASH_SIZE; i++)
+        {
+            for (path_entry *e = path_hash[i]; e; e = e->next)
+            {
+                if (empty)
+                {
+                    printf("hits\tcommand\n");
+                    empty = 0;
+                }
+                printf("%4d\t%s\n", e->hits, e->path);
+            }
+        }
+        if (empty)
+        {
+            printf("hash: hash table empty\n");
+        }
+    }
+    // 清空缓存
+    else if (strcmp(args[1], "-r") == 0)
+    {
+        path_hash_clear();
+    }
+    // 删除指定指令
+    else if (strcmp(args[1], "-d") == 0)
+    {
+        for (int i = 2; args[i] != NULL; i++)
+        {
+            if (path_hash_del(args[i]) != 0)
+            {
+                printf("hash: %s: not found\n", args[i]);
+                result = 1;
+            }
+        }
+    }
+    // 手动指定路径
+    else if (strcmp(args[1], "-p") == 0)
+    {
+        if (args[2] == NULL || args[3] == NULL)
+        {
+            printf("hash: usage: hash -p path name\n");
+            return 1;
+        }
+        path_hash_check();
+        path_hash_add(args[3], args[2], -1);
+    }
+    // 显示指令路径
+    else if (strcmp(args[1], "-t") == 0)
+    {
+        for (int i = 2; args[i] != NULL; i++)
+        {
+            if (find_cmd(args[i], path, sizeof(path)) == 0)
+            {
+                printf("%s\n", path);
+            }
+            else
+            {
+                printf("hash: %s: not found\n", args[i]);
+                result = 1;
+            }
+        }
+    }
+    // 预先查找指令
+    else
+    {
+        for (int i = 1; args[i] != NULL; i++)
+        {
+            if (strchr(args[i], '/') == NULL && find_cmd(args[i], path, sizeof(path)))
+            {
+                printf("hash: %s: not found\n", args[i]);
+                result = 1;
+            }
+        }
+    }
+
+    return result;
+}
+
+// 错误处理
+void error_cmd(char **args)
+{
+    printf("Command \"%s\" not found\n", args[0]);
+    return;
+}
+
+// SIGCHLD信号处理
+void sigchld_handler(int sig)
+{
+    notify_signal(sig);
+}
+
+// SIGTSTP信号处理
+void sigtstp_handler(int sig)
+{
+    notify_signal(sig);
+}
+
+// SININT信号处理
+void sigint_handler(int sig)
+{
+    notify_signal(sig);
+}
+
+// 记录信号并唤醒主循环，只使用async-signal-safe的操作
+void notify_signal(int sig)
+{
+    int saved_errno = errno;
+    unsigned char c = (unsigned char)sig;
+
+    sig_pending[sig] = 1;
+    // pipe已满时丢弃，sig_pending中仍有记录
+    if (write(sig_pipe[1], &c, 1) < 0)
+    {
+    }
+    errno = saved_errno;
+}
+
+// 建立self-pipe并注册信号
+void init_signals()
+{
+    if (pipe(sig_pipe) < 0)
+    {
+        printf("myshell: pipe error: %s\n", strerror(errno));
+        exit(1);
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        fcntl(sig_pipe[i], F_SETFD, FD_CLOEXEC);
+        fcntl(sig_pipe[i], F_SETFL, fcntl(sig_pipe[i], F_GETFL) | O_NONBLOCK);
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+
+    // ctrl+c
+    sa.sa_handler = sigint_handler;
+    sigaction(SIGINT, &sa, NULL);
+    // ctrl+z
+    sa.sa_handler = sigtstp_handler;
+    sigaction(SIGTSTP, &sa, NULL);
+    sa.sa_handler = sigchld_handler;
+    sigaction(SIGCHLD, &sa, NULL);
+
+    // build in指令在shell进程中写入已关闭的管道时不能结束shell
+    signal(SIGPIPE, SIG_IGN);
+}
+
+// 交互模式下让shell成为前台进程组并记录终端设置
+void init_job_control()
+{
+    if (!interactive)
+    {
+        return;
+    }
+
+    // 在后台启动时等待被放到前台
+    while (tcgetpgrp(STDIN_FILENO) != (shell_pgid = getpgrp()))
+    {
+        kill(-shell_pgid, SIGTTIN);
+    }
+
+    // 交出终端后shell在后台调用tcsetpgrp/tcsetattr，不能被暂停
+    signal(SIGTTIN, SIG_IGN);
+    signal(SIGTTOU, SIG_IGN);
+
+    // 会话首进程不能再设置进程组，此时沿用原进程组
+    if (getpid() != getsid(0))
+    {
+        setpgid(0, 0);
+    }
+    shell_pgid = getpgrp();
+    tcsetpgrp(STDIN_FILENO, shell_pgid);
+    tcgetattr(STDIN_FILENO, &shell_tmodes);
+
+    job_control = 1;
+}
+
+// 把终端交给job的进程组，恢复其暂停时的终端设置
+void give_terminal(job *j)
+{
+    if (!job_control)
+    {
+        return;
+    }
+
+    tcsetpgrp(STDIN_FILENO, j->pid);
+    if (j->has_tmodes)
+    {
+        tcsetattr(STDIN_FILENO, TCSADRAIN, &j->tmodes);
+    }
+}
+
+// 取回终端，j不为NULL时保存其终端设置
+void take_terminal(job *j)
+{
+    if (!job_control)
+    {
+        return;
+    }
+
+    if (j != NULL)
+    {
+        j->has_tmodes = tcgetattr(STDIN_FILENO, &j->tmodes) == 0;
+    }
+    tcsetpgrp(STDIN_FILENO, shell_pgid);
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &shell_tmodes);
+}
+
+// 读空self-pipe，处理记录的信号
+void handle_signals()
+{
+    unsigned char buf[256];
+    while (read(sig_pipe[0], buf, sizeof(buf)) > 0)
+        ;
+
+    if (sig_pending[SIGCHLD])
+    {
+        sig_pending[SIGCHLD] = 0;
+        reap_children();
+    }
+
+    // ctrl+c及ctrl+z转发给前景job
+    int sigs[2] = {SIGINT, SIGTSTP};
+    for (int k = 0; k < 2; k++)
+    {
+        if (!sig_pending[sigs[k]])
+        {
+            continue;
+        }
+        sig_pending[sigs[k]] = 0;
+        if (sigs[k] == SIGINT)
+        {
+            interrupted = 1;
+        }
+
+        printf("\n");
+        if (fg_job != NULL && fg_job->pid > 0)
+        {
+            kill(-(fg_job->pid), sigs[k]);
+        }
+    }
+    fflush(stdout);
+}
+
+// 回收所有状态改变的子进程，多个SIGCHLD可能合并为一个
+void reap_children()
+{
+    pid_t pid;
+    int status;
+    struct rusage usage;
+
+    while ((pid = wait4(-1, &status, WNOHANG | WUNTRACED | WCONTINUED, &usage)) > 0)
+    {
+        proc *p = find_proc(pid);
+        if (p == NULL)
+        {
+            continue;
+        }
+        job *j = p->j;
+
+        if (WIFSTOPPED(status))
+        {
+            // 前景job在shell交出终端前访问了终端，此时已取得终端，直接继续
+            if (job_control && j == fg_job && (WSTOPSIG(status) == SIGTTIN || WSTOPSIG(status) == SIGTTOU)
+                && tcgetpgrp(STDIN_FILENO) == j->pid)
+            {
+                kill(pid, SIGCONT);
+                continue;
+            }
+            p->status = STAT_SUSPENDED;
+        }
+        else if (WIFCONTINUED(status))
+        {
+            p->status = STAT_RUNNING;
+        }
+        else
+        {
+            // 保留结束的job及其资源使用，由jobs显示后删除
+            proc_exit(p, status, &usage);
+        }
+        update_job(j);
+    }
+}
+
+// 显示提示符前报告已结束的后台job并删除
+void notify_jobs()
+{
+    reap_children();
+
+    job *next;
+    for (job *j = job_head; j; j = next)
+    {
+        next = j->next;
+        if (j->status == STAT_DONE && !j->is_fg)
+        {
+            print_job_info(j);
+            del_job(j);
+        }
+    }
+    fflush(stdout);
+}
+
+// 等待fd可读或有信号到达，fd为-1时只等待信号
+void wait_event(int fd)
+{
+    struct pollfd fds[2];
+    fds[0].fd = sig_pipe[0];
+    fds[0].events = POLLIN;
+    fds[1].fd = fd;
+    fds[1].events = POLLIN;
+
+    while (1)
+    {
+        int n = poll(fds, fd >= 0 ? 2 : 1, -1);
+        if (n < 0 && errno != EINTR)
+        {
+            return;
+        }
+        if (n > 0 && fds[0].revents)
+        {
+            handle_signals();
+        }
+        // 只等待信号时，处理一次即返回
+        if (fd < 0 || (n > 0 && fds[1].revents))
+        {
+            return;
+        }
+    }
+}
+
+// 等待前景job结束或暂停，返回退出码
+int wait_fg(job *j, int timed)
+{
+    // job状态只在主循环中由reap_children更新
+    while (j->status == STAT_RUNNING || j->status == STAT_CONTINUED)
+    {
+        wait_event(-1);
+    }
+
+    if (j->status == STAT_SUSPENDED)
+    {
+        take_terminal(j);
+        if (job_control)
+        {
+            printf("\n");
+        }
+        print_job_info(j);
+        return 128 + SIGTSTP;
+    }
+
+    take_terminal(NULL);
+
+    // 各阶段退出码
+    int *stage = (int *)arena_alloc(&line_arena, sizeof(int) * j->proc_num);
+    for (int i = 0; i < j->proc_num; i++)
+    {
+        stage[i] = j->procs[i].exit_status;
+    }
+    set_pipe_status(stage, j->proc_num);
+
+    int status = j->exit_status;
+    // 终端直接把ctrl+c发给job，由shell补上换行，并停止执行循环等后续指令
+    if (job_control && status == 128 + SIGINT)
+    {
+        printf("\n");
+        interrupted = 1;
+    }
+    if (timed)
+    {
+        print_time_usage(ts_diff(&j->end, &j->start), &j->usage);
+    }
+    del_job(j);
+    return status;
+}
+
+// wait指令
+int my_wait(char **args)
+{
+    int first = 0;
+    int worst = 0;
+    int i = 1;
+
+    // 选项
+    for (; args[i] != NULL && args[i][0] == '-'; i++)
+    {
+        for (char *p = args[i] + 1; *p; p++)
+        {
+            if (*p == 'n')
+            {
+                first = 1;
+            }
+            else if (*p == 'a')
+            {
+                worst = 1;
+            }
+            else
+            {
+                printf("wait: error option: %s\n", args[i]);
+                return 2;
+            }
+        }
+    }
+
+    // 指定的job，未指定时为全部job
+    int named = args[i] != NULL;
+    int cap = 1;
+    for (int k = i; args[k] != NULL; k++)
+    {
+        cap++;
+    }
+    for (job *j = job_head; j; j = j->next)
+    {
+        cap++;
+    }
+
+    int num = 0;
+    job **list = (job **)arena_alloc(&line_arena, sizeof(job *) * cap);
+    for (; args[i] != NULL; i++)
+    {
+        job *j = find_job("wait", args[i]);
+        if (j == NULL)
+        {
+            return 127;
+        }
+        int dup = 0;
+        for (int k = 0; k < num; k++)
+        {
+            dup |= list[k] == j;
+        }
+        if (!dup)
+        {
+            list[num++] = j;
+        }
+    }
+    if (num == 0)
+    {
+        for (job *j = job_head; j; j = j->next)
+        {
+            if (!j->busy)
+            {
+                list[num++] = j;
+            }
+        }
+    }
+
+    interrupted = 0;
+    int status = 0;
+    int worst_status = 0;
+
+    // 等待第一个结束的job
+    if (first)
+    {
+        while (1)
+        {
+            int pending = 0;
+            for (int k = 0; k < num; k++)
+            {
+                if (list[k]->status == STAT_DONE)
+                {
+                    status = list[k]->exit_status;
+                    del_job(list[k]);
+                    return status;
+                }
+                pending |= job_pending(list[k]);
+            }
+            // 没有可等待的job
+            if (!pending)
+            {
+                return 127;
+            }
+
+            wait_event(-1);
+            if (interrupted)
+            {
+                return 128 + SIGINT;
+            }
+        }
+    }
+
+    // 依次等待全部job，暂停的job不再等待
+    for (int k = 0; k < num; k++)
+    {
+        while (job_pending(list[k]))
+        {
+            wait_event(-1);
+            if (interrupted)
+            {
+                return 128 + SIGINT;
+            }
+        }
+
+        if (list[k]->status == STAT_DONE)
+        {
+            status = list[k]->exit_status;
+            del_job(list[k]);
+        }
+        else
+        {
+            status = 128 + SIGTSTP;
+        }
+
+        if (status > worst_status)
+        {
+            worst_status = status;
+        }
+    }
+
+    if (worst)
+    {
+        return worst_status;
+    }
+    // 与bash相同，未指定job时返回0，否则为最后一个job的退出码
+    return named ? status : 0;
+}
+
+// SIGQUIT信号处理
+void sigquit_handler(int sig)
+{
+    return;
 }
\ No newline at end of file